@@ -0,0 +1,268 @@
+/*
+    Description:    Implementation of the streaming BMP writer and the banded renderer (see bmp-writer.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "bmp-writer.h"
+#include "byte-order.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// file header, 40-byte info header and a 256 entry palette
+static const size_t fileHeaderSize = 14;
+static const size_t infoHeaderSize = 40;
+static const size_t paletteSize = 256 * 4;
+
+// ------------------------------------------------------------------
+// BmpWriter
+// ------------------------------------------------------------------
+
+BmpWriter::BmpWriter() {
+    reset();
+}
+
+BmpWriter::~BmpWriter() {
+    if (file.is_open()) {
+        file.close();
+    }
+}
+
+void BmpWriter::reset() {
+    rows = 0;
+    cols = 0;
+    rowsWritten = 0;
+    padding.clear();
+}
+
+bool BmpWriter::open(const string& path, int rows, int cols) {
+    if (file.is_open()) {
+        file.close();
+    }
+    reset();
+
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+
+    // rows are padded to a multiple of 4 bytes
+    unsigned long long rowSize = (static_cast<unsigned long long>(cols) + 3) / 4 * 4;
+    unsigned long long pixelOffset = fileHeaderSize + infoHeaderSize + paletteSize;
+    unsigned long long fileSize = pixelOffset + rowSize * rows;
+
+    // the size fields are 32 bits wide
+    if (fileSize > UINT32_MAX) {
+        return false;
+    }
+
+    file.open(path, ios::binary | ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    vector<unsigned char> header;
+    header.reserve(static_cast<size_t>(pixelOffset));
+
+    // file header
+    header.push_back('B');
+    header.push_back('M');
+    putInt(header, static_cast<uint32_t>(fileSize));
+    putInt(header, 0); // reserved
+    putInt(header, static_cast<uint32_t>(pixelOffset));
+
+    // info header, a positive height means the rows are stored bottom-up
+    putInt(header, static_cast<uint32_t>(infoHeaderSize));
+    putInt(header, static_cast<uint32_t>(cols));
+    putInt(header, static_cast<uint32_t>(rows));
+    putShort(header, 1); // planes
+    putShort(header, 8); // bits per pixel
+    putInt(header, 0); // no compression
+    putInt(header, static_cast<uint32_t>(rowSize * rows));
+    putInt(header, 2835); // 72 dpi, horizontal
+    putInt(header, 2835); // and vertical
+    putInt(header, 256); // colours used
+    putInt(header, 0); // all colours important
+
+    // grey ramp: blue, green, red, reserved
+    for (int i = 0; i < 256; i++) {
+        header.push_back(static_cast<unsigned char>(i));
+        header.push_back(static_cast<unsigned char>(i));
+        header.push_back(static_cast<unsigned char>(i));
+        header.push_back(0);
+    }
+
+    file.write((const char*)header.data(), header.size());
+
+    this->rows = rows;
+    this->cols = cols;
+    padding.assign(static_cast<size_t>(rowSize - cols), 0);
+
+    return static_cast<bool>(file);
+}
+
+bool BmpWriter::writeRow(const unsigned char* row) {
+    if (!file.is_open() || rowsWritten == rows) {
+        return false;
+    }
+
+    file.write((const char*)row, cols);
+    if (!padding.empty()) {
+        file.write((const char*)padding.data(), padding.size());
+    }
+    rowsWritten++;
+
+    return static_cast<bool>(file);
+}
+
+bool BmpWriter::close() {
+    if (!file.is_open()) {
+        return false;
+    }
+
+    bool complete = rowsWritten == rows;
+    file.close();
+    bool written = !file.fail();
+
+    reset();
+    return complete && written;
+}
+
+// ------------------------------------------------------------------
+// banded rendering
+// ------------------------------------------------------------------
+
+// bands are numbered in the order they are written, i.e. from the bottom of the image up. workers
+// claim bands in that order and render band k into slot k % slots once band k - slots has been
+// written, so no more than slots bands are ever held at once
+struct BandPipeline {
+    const QuadTree* quadTree;
+    int bandRows;
+    int bandCount;
+    int slots;
+
+    vector<vector<unsigned char>> buffers;
+    vector<int> ready; // band rendered into each slot, -1 while the slot is free or being rendered
+
+    mutex lock;
+    condition_variable changed;
+    int nextBand; // next band to be claimed by a worker
+    int written; // bands written to the file so far
+    bool failed;
+};
+
+// first image row of the band written k-th
+static int bandTop(const BandPipeline& pipeline, int k) {
+    return (pipeline.bandCount - 1 - k) * pipeline.bandRows;
+}
+
+static int bandHeight(const BandPipeline& pipeline, int k) {
+    int top = bandTop(pipeline, k);
+    return min(pipeline.bandRows, pipeline.quadTree->rows - top);
+}
+
+static void renderBands(BandPipeline& pipeline) {
+    int cols = pipeline.quadTree->cols;
+
+    while (true) {
+        int k;
+        {
+            unique_lock<mutex> guard(pipeline.lock);
+            if (pipeline.failed || pipeline.nextBand == pipeline.bandCount) {
+                return;
+            }
+            k = pipeline.nextBand++;
+
+            // wait for the band that last used this slot to be written
+            pipeline.changed.wait(guard, [&]() { return pipeline.failed || k < pipeline.written + pipeline.slots; });
+            if (pipeline.failed) {
+                return;
+            }
+        }
+
+        // only the nodes that intersect the band are visited
+        vector<unsigned char>& buffer = pipeline.buffers[k % pipeline.slots];
+        int rows = bandHeight(pipeline, k);
+        memset(buffer.data(), 0, static_cast<size_t>(rows) * cols);
+        pipeline.quadTree->renderRegion(bandTop(pipeline, k), 0, rows, cols, buffer.data(), cols);
+
+        {
+            lock_guard<mutex> guard(pipeline.lock);
+            pipeline.ready[k % pipeline.slots] = k;
+        }
+        pipeline.changed.notify_all();
+    }
+}
+
+bool writeQuadTreeBmp(const QuadTree& quadTree, const string& path, int bandRows, unsigned threads) {
+    if (quadTree.root == nullptr || bandRows <= 0) {
+        return false;
+    }
+
+    BmpWriter writer;
+    if (!writer.open(path, quadTree.rows, quadTree.cols)) {
+        return false;
+    }
+
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+
+    BandPipeline pipeline;
+    pipeline.quadTree = &quadTree;
+    pipeline.bandRows = bandRows;
+    pipeline.bandCount = (quadTree.rows + bandRows - 1) / bandRows;
+    pipeline.slots = static_cast<int>(min<unsigned>(threads, pipeline.bandCount));
+    pipeline.buffers.assign(pipeline.slots, vector<unsigned char>(static_cast<size_t>(bandRows) * quadTree.cols));
+    pipeline.ready.assign(pipeline.slots, -1);
+    pipeline.nextBand = 0;
+    pipeline.written = 0;
+    pipeline.failed = false;
+
+    vector<thread> workers;
+    for (int i = 0; i < pipeline.slots; i++) {
+        workers.push_back(thread(renderBands, ref(pipeline)));
+    }
+
+    // write the bands in order as they are finished, rows from the bottom of each band up
+    for (int k = 0; k < pipeline.bandCount; k++) {
+        int slot = k % pipeline.slots;
+        {
+            unique_lock<mutex> guard(pipeline.lock);
+            pipeline.changed.wait(guard, [&]() { return pipeline.ready[slot] == k; });
+        }
+
+        const vector<unsigned char>& buffer = pipeline.buffers[slot];
+        bool ok = true;
+        for (int i = bandHeight(pipeline, k) - 1; i >= 0 && ok; i--) {
+            ok = writer.writeRow(buffer.data() + static_cast<size_t>(i) * quadTree.cols);
+        }
+
+        {
+            lock_guard<mutex> guard(pipeline.lock);
+            pipeline.ready[slot] = -1;
+            pipeline.written++;
+            if (!ok) {
+                pipeline.failed = true;
+            }
+        }
+        pipeline.changed.notify_all();
+
+        if (!ok) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    return writer.close() && !pipeline.failed;
+}
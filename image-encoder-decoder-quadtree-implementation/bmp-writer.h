@@ -0,0 +1,53 @@
+/*
+    Description:    Constant-memory output path for the decoder. BmpWriter streams an 8-bit grayscale
+                    BMP to disk one row at a time, and writeQuadTreeBmp renders the image in horizontal
+                    bands on a few worker threads, each band painted only from the nodes that intersect
+                    it, handing finished bands to the writer in file order. Only one band per thread is
+                    ever held in memory, however large the image is.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "quadtree-codec.h"
+
+// rows per band when the caller doesn't choose
+const int defaultBandRows = 64;
+
+// sequential writer for an 8-bit BMP with a grey ramp palette. rows are stored bottom-up, as most
+// readers expect, so they must be handed over starting with the last row of the image
+class BmpWriter {
+public:
+    BmpWriter();
+    ~BmpWriter();
+
+    BmpWriter(const BmpWriter&) = delete;
+    BmpWriter& operator=(const BmpWriter&) = delete;
+
+    // creates the file and writes the headers and palette, returns false if it can't be written
+    bool open(const std::string& path, int rows, int cols);
+
+    // appends the next row (cols bytes) in file order
+    bool writeRow(const unsigned char* row);
+
+    // returns false if any row is missing or a write failed
+    bool close();
+
+private:
+    std::ofstream file;
+    int rows, cols;
+    int rowsWritten;
+    std::vector<unsigned char> padding; // zero bytes padding a row to a multiple of 4
+
+    void reset();
+};
+
+// decodes the tree straight into a BMP file. threads of 0 means one per hardware thread. peak
+// memory is about bandRows * cols * threads bytes (plus the tree), independent of the image height
+bool writeQuadTreeBmp(const QuadTree& quadTree, const std::string& path, int bandRows = defaultBandRows, unsigned threads = 0);
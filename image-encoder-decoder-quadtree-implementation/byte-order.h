@@ -0,0 +1,45 @@
+/*
+    Description:    Little-endian helpers shared by every binary format the project reads or writes.
+                    put* appends a value to a byte buffer, get* reads one back from raw bytes; both
+                    work the same on any host byte order.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+inline void putShort(std::vector<unsigned char>& out, uint16_t value) {
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+inline void putInt(std::vector<unsigned char>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+inline void putLong(std::vector<unsigned char>& out, uint64_t value) {
+    putInt(out, static_cast<uint32_t>(value));
+    putInt(out, static_cast<uint32_t>(value >> 32));
+}
+
+inline uint16_t getShort(const unsigned char* in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+inline uint32_t getInt(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline uint64_t getLong(const unsigned char* in) {
+    return getInt(in) | (static_cast<uint64_t>(getInt(in + 4)) << 32);
+}
@@ -15,6 +15,7 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/highgui.hpp>
+#include <cmath>
 #include <iostream>
 
 // namespace(s)
@@ -24,6 +25,7 @@ using namespace std;
 // user defined functions 
 double calculateValueX(int**, int**, int, int);
 double gammaValue(double, double);
+double psnrValue(double, double);
 
 // driver code
 int main() {
@@ -87,6 +89,7 @@ int main() {
     double Y = gammaValue(X, 255);
 
     cout << "Accuracy(MSE): " << Y << "%" << endl;
+    cout << "PSNR: " << psnrValue(X, 255) << " dB" << endl;
 
     // deallocate memory
     for (int i = 0; i < rowO; i++) {
@@ -121,6 +124,14 @@ double gammaValue(double X, double Z = 255) {
     return 100 * (1 - (X / (Z * Z)));
 }
 
+// peak signal to noise ratio for the lossy mode, infinite when both images are identical
+double psnrValue(double X, double Z = 255) {
+    if (X == 0) {
+        return INFINITY;
+    }
+    return 10 * log10((Z * Z) / X);
+}
+
 
 
 
@@ -0,0 +1,89 @@
+/*
+    Description:    Dispatch from runtime block sizes to the compile-time leaf-block kernels (see leaf-block.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "leaf-block.h"
+
+template<PixelFormat Format, int Rows>
+static LeafBlockPacker packerForRows(int cols) {
+    switch (cols) {
+    case 1: return &packLeafBlock<Format, Rows, 1>;
+    case 2: return &packLeafBlock<Format, Rows, 2>;
+    case 3: return &packLeafBlock<Format, Rows, 3>;
+    case 4: return &packLeafBlock<Format, Rows, 4>;
+    case 5: return &packLeafBlock<Format, Rows, 5>;
+    case 6: return &packLeafBlock<Format, Rows, 6>;
+    case 7: return &packLeafBlock<Format, Rows, 7>;
+    default: return &packLeafBlock<Format, Rows, 8>;
+    }
+}
+
+template<PixelFormat Format>
+static LeafBlockPacker packerForFormat(int rows, int cols) {
+    switch (rows) {
+    case 1: return packerForRows<Format, 1>(cols);
+    case 2: return packerForRows<Format, 2>(cols);
+    case 3: return packerForRows<Format, 3>(cols);
+    case 4: return packerForRows<Format, 4>(cols);
+    case 5: return packerForRows<Format, 5>(cols);
+    case 6: return packerForRows<Format, 6>(cols);
+    case 7: return packerForRows<Format, 7>(cols);
+    default: return packerForRows<Format, 8>(cols);
+    }
+}
+
+LeafBlockPacker leafBlockPacker(PixelFormat format, int rows, int cols) {
+    switch (format) {
+    case gray8: return packerForFormat<gray8>(rows, cols);
+    case indexed8: return packerForFormat<indexed8>(rows, cols);
+    case indexed1: return packerForFormat<indexed1>(rows, cols);
+    case bgr24: return packerForFormat<bgr24>(rows, cols);
+    default: return packerForFormat<bgra32>(rows, cols);
+    }
+}
+
+template<int Rows>
+static const LeafBlockShape& shapeForRows(int cols) {
+    switch (cols) {
+    case 1: return leafBlockShapeOf<Rows, 1>;
+    case 2: return leafBlockShapeOf<Rows, 2>;
+    case 3: return leafBlockShapeOf<Rows, 3>;
+    case 4: return leafBlockShapeOf<Rows, 4>;
+    case 5: return leafBlockShapeOf<Rows, 5>;
+    case 6: return leafBlockShapeOf<Rows, 6>;
+    case 7: return leafBlockShapeOf<Rows, 7>;
+    default: return leafBlockShapeOf<Rows, 8>;
+    }
+}
+
+const LeafBlockShape& leafBlockShape(int rows, int cols) {
+    switch (rows) {
+    case 1: return shapeForRows<1>(cols);
+    case 2: return shapeForRows<2>(cols);
+    case 3: return shapeForRows<3>(cols);
+    case 4: return shapeForRows<4>(cols);
+    case 5: return shapeForRows<5>(cols);
+    case 6: return shapeForRows<6>(cols);
+    case 7: return shapeForRows<7>(cols);
+    default: return shapeForRows<8>(cols);
+    }
+}
+
+int leafBlockNodeCount(const LeafBlockShape& shape, uint64_t bits) {
+    int count = 0;
+
+    // pre-order walk, homogeneous nodes jump over their descendants
+    for (int i = 0; i < shape.count;) {
+        uint64_t covered = bits & shape.mask[i];
+        count++;
+
+        if (covered == 0 || covered == shape.mask[i])
+            i += shape.size[i];
+        else
+            i++;
+    }
+    return count;
+}
@@ -0,0 +1,129 @@
+/*
+    Description:    Terminal level of the quadtree. Blocks of at most 8x8 pixels holding white plus one
+                    other colour are packed into a 64-bit bitboard (bit i * 8 + j is pixel (i, j) of the
+                    block) and stored as a single leaf-block record instead of a subtree of TreeNodes.
+                    The subtree the record stands for is never built: its shape is described by
+                    compile-time tables of per-node bit masks, one table per block size.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "quadtree-codec.h"
+
+// largest block (in both dimensions) stored as a leaf-block record
+const int leafBlockSize = 8;
+
+// nodes in the full subtree of an 8x8 block (1 + 4 + 16 + 64)
+const int leafBlockMaxNodes = 85;
+
+// bits of the rectangle [top, bottom) x [left, right) of a block
+constexpr uint64_t leafBlockRegionMask(int top, int left, int bottom, int right) {
+    uint64_t rowBits = ((1ULL << (right - left)) - 1) << left;
+    uint64_t mask = 0;
+    for (int i = top; i < bottom; i++) {
+        mask |= rowBits << (8 * i);
+    }
+    return mask;
+}
+
+// number of set bits
+inline int popCount(uint64_t bits) {
+    bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((bits * 0x0101010101010101ULL) >> 56);
+}
+
+// the complete subtree of a rows x cols block in pre-order, split exactly like buildQuadTree splits.
+// a node is a leaf when the bitboard is all set or all clear under its mask, in which case its
+// size[] descendants are skipped
+struct LeafBlockShape {
+    int count;
+    uint64_t mask[leafBlockMaxNodes];
+    unsigned char xStart[leafBlockMaxNodes], yStart[leafBlockMaxNodes];
+    unsigned char xEnd[leafBlockMaxNodes], yEnd[leafBlockMaxNodes];
+    unsigned char size[leafBlockMaxNodes]; // nodes in the subtree rooted here, itself included
+    signed char children[leafBlockMaxNodes][4]; // nw, ne, sw, se, -1 when the quadrant is empty
+};
+
+constexpr int addLeafBlockShapeNode(LeafBlockShape& shape, int xStart, int yStart, int xEnd, int yEnd) {
+    int index = shape.count++;
+
+    shape.mask[index] = leafBlockRegionMask(xStart, yStart, xEnd, yEnd);
+    shape.xStart[index] = static_cast<unsigned char>(xStart);
+    shape.yStart[index] = static_cast<unsigned char>(yStart);
+    shape.xEnd[index] = static_cast<unsigned char>(xEnd);
+    shape.yEnd[index] = static_cast<unsigned char>(yEnd);
+    for (int i = 0; i < 4; i++) {
+        shape.children[index][i] = -1;
+    }
+
+    // a single pixel is always homogeneous
+    if (xEnd - xStart > 1 || yEnd - yStart > 1) {
+        int xMid = xStart + (xEnd - xStart) / 2;
+        int yMid = yStart + (yEnd - yStart) / 2;
+
+        if (xMid > xStart && yMid > yStart)
+            shape.children[index][0] = static_cast<signed char>(addLeafBlockShapeNode(shape, xStart, yStart, xMid, yMid));
+        if (xMid > xStart)
+            shape.children[index][1] = static_cast<signed char>(addLeafBlockShapeNode(shape, xStart, yMid, xMid, yEnd));
+        if (yMid > yStart)
+            shape.children[index][2] = static_cast<signed char>(addLeafBlockShapeNode(shape, xMid, yStart, xEnd, yMid));
+        shape.children[index][3] = static_cast<signed char>(addLeafBlockShapeNode(shape, xMid, yMid, xEnd, yEnd));
+    }
+
+    shape.size[index] = static_cast<unsigned char>(shape.count - index);
+    return index;
+}
+
+constexpr LeafBlockShape makeLeafBlockShape(int rows, int cols) {
+    LeafBlockShape shape{};
+    addLeafBlockShapeNode(shape, 0, 0, rows, cols);
+    return shape;
+}
+
+template<int Rows, int Cols>
+constexpr LeafBlockShape leafBlockShapeOf = makeLeafBlockShape(Rows, Cols);
+
+// packs the Rows x Cols block at (x, y) into bits (set where the pixel is not white).
+// fails when the block holds two different non-white colours, color receives the non-white
+// colour (or 255 if the block is all white)
+template<PixelFormat Format, int Rows, int Cols>
+bool packLeafBlock(const ImageView& image, int x, int y, int& color, uint64_t& bits) {
+    int other = -1;
+    bits = 0;
+
+    for (int i = 0; i < Rows; i++) {
+        const unsigned char* row = image.data + (x + i) * image.stride;
+        for (int j = 0; j < Cols; j++) {
+            int value = ImageView::readPixel<Format>(row, y + j, image.palette);
+            if (value == 255) {
+                continue;
+            }
+            if (other != value) {
+                if (other != -1) {
+                    return false;
+                }
+                other = value;
+            }
+            bits |= 1ULL << (8 * i + j);
+        }
+    }
+
+    color = (other == -1) ? 255 : other;
+    return true;
+}
+
+typedef bool (*LeafBlockPacker)(const ImageView& image, int x, int y, int& color, uint64_t& bits);
+
+// the kernels for a rows x cols block of an image stored in format, 1 <= rows, cols <= leafBlockSize
+LeafBlockPacker leafBlockPacker(PixelFormat format, int rows, int cols);
+const LeafBlockShape& leafBlockShape(int rows, int cols);
+
+// nodes in the subtree a leaf block with these bits stands for
+int leafBlockNodeCount(const LeafBlockShape& shape, uint64_t bits);
@@ -0,0 +1,274 @@
+/*
+    Description:    Implementation of the lossy grayscale / colour codec (see lossy-codec.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "lossy-codec.h"
+#include "byte-order.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+// ------------------------------------------------------------------
+// lossy quadtree (CodecContext)
+// ------------------------------------------------------------------
+
+// sum over the block [x, x + rows) x [y, y + cols) of an integral image with cols + 1 columns
+static unsigned long long blockSum(const vector<unsigned long long>& integral, int imageCols, int x, int y, int rows, int cols) {
+    size_t width = static_cast<size_t>(imageCols) + 1;
+    size_t top = x * width, bottom = (x + rows) * width;
+    return integral[bottom + y + cols] - integral[bottom + y] - integral[top + y + cols] + integral[top + y];
+}
+
+// true if every pixel of the block is within threshold of mean
+template<PixelFormat Format>
+static bool isWithinDeviationAs(const ImageView& image, int x, int y, int rows, int cols, double mean, double threshold) {
+    double low = mean - threshold, high = mean + threshold;
+
+    for (int i = x; i < (x + rows); i++) {
+        const unsigned char* row = image.data + i * image.stride;
+        for (int j = y; j < (y + cols); j++) {
+            int value = ImageView::readPixel<Format>(row, j, image.palette);
+            if (value < low || value > high) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool isWithinDeviation(const ImageView& image, int x, int y, int rows, int cols, double mean, double threshold) {
+    switch (image.format) {
+    case gray8:
+        return isWithinDeviationAs<gray8>(image, x, y, rows, cols, mean, threshold);
+    case indexed8:
+        return isWithinDeviationAs<indexed8>(image, x, y, rows, cols, mean, threshold);
+    case indexed1:
+        return isWithinDeviationAs<indexed1>(image, x, y, rows, cols, mean, threshold);
+    case bgr24:
+        return isWithinDeviationAs<bgr24>(image, x, y, rows, cols, mean, threshold);
+    default:
+        return isWithinDeviationAs<bgra32>(image, x, y, rows, cols, mean, threshold);
+    }
+}
+
+TreeNode* CodecContext::buildLossyNode(const ImageView& image, const LossyOptions& options, int xStart, int yStart, int xEnd, int yEnd) {
+    int rows = xEnd - xStart;
+    int cols = yEnd - yStart;
+    double count = static_cast<double>(rows) * cols;
+
+    double mean = blockSum(sums, image.cols, xStart, yStart, rows, cols) / count;
+    double variance = max(0.0, blockSum(squaredSums, image.cols, xStart, yStart, rows, cols) / count - mean * mean);
+
+    TreeNode* node = newNode(static_cast<int>(mean + 0.5), xStart, yStart, xEnd, yEnd);
+
+    bool withinThreshold;
+    if (rows == 1 && cols == 1)
+        withinThreshold = true;
+    else if (options.criterion == splitOnVariance)
+        withinThreshold = variance <= options.threshold;
+    else
+        // the largest deviation is at least the standard deviation, so most blocks that must be
+        // split are caught by the integral images without scanning their pixels
+        withinThreshold = sqrt(variance) <= options.threshold && isWithinDeviation(image, xStart, yStart, rows, cols, mean, options.threshold);
+
+    if (withinThreshold == false) {
+        node->checkLeaf = false; // not a leaf node
+        node->color = -1; // grey color
+
+        int xMid = xStart + rows / 2;
+        int yMid = yStart + cols / 2;
+
+        if (xMid > xStart && yMid > yStart)
+            node->children[0] = buildLossyNode(image, options, xStart, yStart, xMid, yMid);
+        if (xMid > xStart)
+            node->children[1] = buildLossyNode(image, options, xStart, yMid, xMid, yEnd);
+        if (yMid > yStart)
+            node->children[2] = buildLossyNode(image, options, xMid, yStart, xEnd, yMid);
+        node->children[3] = buildLossyNode(image, options, xMid, yMid, xEnd, yEnd);
+    }
+
+    node->blackCount = computeBlackCount(node);
+    return node;
+}
+
+const QuadTree& CodecContext::buildLossyQuadTree(const ImageView& image, const LossyOptions& options) {
+    pool.reset();
+
+    quadTree.rows = image.rows;
+    quadTree.cols = image.cols;
+    quadTree.root = nullptr;
+
+    if (image.rows == 0 || image.cols == 0) {
+        return quadTree;
+    }
+
+    // integral images: entry (i, j) holds the sum over the pixels above and to the left of (i, j)
+    size_t width = static_cast<size_t>(image.cols) + 1;
+    sums.assign((image.rows + 1) * width, 0);
+    squaredSums.assign((image.rows + 1) * width, 0);
+
+    for (int i = 0; i < image.rows; i++) {
+        unsigned long long rowSum = 0, rowSquaredSum = 0;
+
+        for (int j = 0; j < image.cols; j++) {
+            unsigned long long value = image.pixel(i, j);
+            rowSum += value;
+            rowSquaredSum += value * value;
+
+            sums[(i + 1) * width + j + 1] = sums[i * width + j + 1] + rowSum;
+            squaredSums[(i + 1) * width + j + 1] = squaredSums[i * width + j + 1] + rowSquaredSum;
+        }
+    }
+
+    quadTree.root = buildLossyNode(image, options, 0, 0, image.rows, image.cols);
+    return quadTree;
+}
+
+void CodecContext::encodeLossy(const ImageView& image, const LossyOptions& options, vector<unsigned char>& out) {
+    buildLossyQuadTree(image, options);
+    serialize(out);
+}
+
+// ------------------------------------------------------------------
+// colour codec
+// ------------------------------------------------------------------
+
+static const unsigned char colorFormatMagic[4] = { 'Q', 'T', 'C', 'B' };
+static const size_t colorHeaderSize = 12;
+
+ColorCodecContext::ColorCodecContext() {
+}
+
+void ColorCodecContext::buildQuadTrees(const unsigned char* bgr, int rows, int cols, ptrdiff_t stride, const LossyOptions& options) {
+    // de-interleave the channels so each tree reads a plain grayscale plane
+    for (int c = 0; c < 3; c++) {
+        planes[c].resize(static_cast<size_t>(rows) * cols);
+    }
+    for (int i = 0; i < rows; i++) {
+        const unsigned char* row = bgr + i * stride;
+        for (int j = 0; j < cols; j++) {
+            for (int c = 0; c < 3; c++) {
+                planes[c][static_cast<size_t>(i) * cols + j] = row[3 * j + c];
+            }
+        }
+    }
+
+    // one thread per channel, each channel has its own context so nothing is shared
+    thread workers[3];
+    for (int c = 0; c < 3; c++) {
+        workers[c] = thread([this, c, rows, cols, &options]() {
+            channels[c].buildLossyQuadTree(ImageView(planes[c].data(), rows, cols, cols), options);
+        });
+    }
+    for (int c = 0; c < 3; c++) {
+        workers[c].join();
+    }
+}
+
+void ColorCodecContext::serialize(vector<unsigned char>& out) {
+    for (int c = 0; c < 3; c++) {
+        channels[c].serialize(channelBuffers[c]);
+    }
+
+    out.clear();
+    out.reserve(colorHeaderSize + 3 * 4 + channelBuffers[0].size() + channelBuffers[1].size() + channelBuffers[2].size());
+
+    out.insert(out.end(), colorFormatMagic, colorFormatMagic + 4);
+    putInt(out, static_cast<uint32_t>(channels[0].tree().rows));
+    putInt(out, static_cast<uint32_t>(channels[0].tree().cols));
+
+    for (int c = 0; c < 3; c++) {
+        putInt(out, static_cast<uint32_t>(channelBuffers[c].size()));
+        out.insert(out.end(), channelBuffers[c].begin(), channelBuffers[c].end());
+    }
+}
+
+void ColorCodecContext::encode(const unsigned char* bgr, int rows, int cols, ptrdiff_t stride, const LossyOptions& options, vector<unsigned char>& out) {
+    buildQuadTrees(bgr, rows, cols, stride, options);
+    serialize(out);
+}
+
+bool ColorCodecContext::decode(const unsigned char* data, size_t size, vector<unsigned char>& bgr, int& rows, int& cols, long long maxPixels) {
+    if (size < colorHeaderSize || memcmp(data, colorFormatMagic, 4) != 0) {
+        return false;
+    }
+
+    rows = static_cast<int>(getInt(data + 4));
+    cols = static_cast<int>(getInt(data + 8));
+
+    // the dimensions come from the (untrusted) header, check them before allocating
+    if (rows < 0 || cols < 0 || static_cast<long long>(rows) * cols > maxPixels) {
+        return false;
+    }
+
+    // locate the three channel buffers
+    const unsigned char* channelData[3];
+    size_t channelSize[3];
+    size_t offset = colorHeaderSize;
+
+    for (int c = 0; c < 3; c++) {
+        if (size - offset < 4) {
+            return false;
+        }
+        channelSize[c] = getInt(data + offset);
+        offset += 4;
+
+        if (size - offset < channelSize[c]) {
+            return false;
+        }
+        channelData[c] = data + offset;
+        offset += channelSize[c];
+    }
+    if (offset != size) {
+        return false;
+    }
+
+    // parse and render the channels in parallel
+    bool parsed[3];
+    thread workers[3];
+    for (int c = 0; c < 3; c++) {
+        workers[c] = thread([this, c, &channelData, &channelSize, &parsed, rows, cols, maxPixels]() {
+            int channelRows, channelCols;
+            parsed[c] = channels[c].decode(channelData[c], channelSize[c], planes[c], channelRows, channelCols, maxPixels) &&
+                channelRows == rows && channelCols == cols;
+        });
+    }
+    for (int c = 0; c < 3; c++) {
+        workers[c].join();
+    }
+    if (!parsed[0] || !parsed[1] || !parsed[2]) {
+        return false;
+    }
+
+    bgr.resize(static_cast<size_t>(rows) * cols * 3);
+    for (size_t i = 0; i < static_cast<size_t>(rows) * cols; i++) {
+        for (int c = 0; c < 3; c++) {
+            bgr[3 * i + c] = planes[c][i];
+        }
+    }
+    return true;
+}
+
+double computePsnr(const unsigned char* original, const unsigned char* decoded, size_t count) {
+    double squaredError = 0;
+    for (size_t i = 0; i < count; i++) {
+        double difference = static_cast<double>(original[i]) - decoded[i];
+        squaredError += difference * difference;
+    }
+
+    if (squaredError == 0) {
+        return numeric_limits<double>::infinity();
+    }
+
+    double mse = squaredError / count;
+    return 10 * log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,72 @@
+/*
+    Description:    Lossy mode for 8-bit grayscale and BGR images. Instead of splitting every block that
+                    is not a single colour, a block becomes a leaf holding its mean once it is close
+                    enough to uniform: its variance, or the largest deviation of a pixel from the mean,
+                    is within a threshold. Block sums come from integral images of the pixel values and
+                    their squares, so testing a block costs O(1). Colour images get one tree per channel,
+                    built in parallel.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "quadtree-codec.h"
+
+enum SplitCriterion {
+    splitOnVariance,     // leaf when the block variance <= threshold (squared grey levels)
+    splitOnMaxDeviation  // leaf when every pixel is within threshold grey levels of the block mean
+};
+
+struct LossyOptions {
+    SplitCriterion criterion;
+    double threshold;
+
+    LossyOptions() {
+        criterion = splitOnVariance;
+        threshold = 0;
+    }
+
+    LossyOptions(SplitCriterion criterion, double threshold) {
+        this->criterion = criterion;
+        this->threshold = threshold;
+    }
+};
+
+// lossy codec for interleaved 8-bit BGR images: one CodecContext (tree, node pool, integral images)
+// per channel. like CodecContext it must not be used by two threads at the same time
+class ColorCodecContext {
+public:
+    ColorCodecContext();
+
+    ColorCodecContext(const ColorCodecContext&) = delete;
+    ColorCodecContext& operator=(const ColorCodecContext&) = delete;
+
+    // build the three channel trees in parallel, they stay valid until the next call on this context
+    void buildQuadTrees(const unsigned char* bgr, int rows, int cols, std::ptrdiff_t stride, const LossyOptions& options);
+
+    // build the channel trees and serialize them into out
+    void encode(const unsigned char* bgr, int rows, int cols, std::ptrdiff_t stride, const LossyOptions& options, std::vector<unsigned char>& out);
+
+    // serialized format: "QTCB", rows, cols, then per channel (b, g, r) its size and its quadtree buffer
+    void serialize(std::vector<unsigned char>& out);
+
+    // parse the channel trees and render them into bgr (rows * cols * 3 bytes). returns false
+    // without allocating if the header claims more than maxPixels pixels
+    bool decode(const unsigned char* data, std::size_t size, std::vector<unsigned char>& bgr, int& rows, int& cols,
+        long long maxPixels = defaultMaxDecodePixels);
+
+    const QuadTree& tree(int channel) const { return channels[channel].tree(); }
+
+private:
+    CodecContext channels[3];
+    std::vector<unsigned char> planes[3]; // de-interleaved channels, reused between calls
+    std::vector<unsigned char> channelBuffers[3];
+};
+
+// peak signal to noise ratio in dB between two buffers of count 8-bit samples, infinite if equal
+double computePsnr(const unsigned char* original, const unsigned char* decoded, std::size_t count);
@@ -0,0 +1,104 @@
+/*
+    Description:    This program encodes a grayscale or colour image with the lossy quadtree codec at a
+                    range of thresholds and reports, for each threshold, the size of the encoded image
+                    against the quality (PSNR) of its decoded version.
+
+    Note:           This program is written in C++ and uses OpenCV library to read the image. The encoding
+                    itself lives in the lossy codec library (lossy-codec.h).
+
+    Usage:          lossy-encoder [input image] [gray | color] [variance | deviation] [threshold ...]
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+// headers
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy-codec.h"
+
+// namespaces
+using namespace std;
+
+// driver code
+int main(int argc, char* argv[]) {
+    string imagePath = (argc > 1) ? argv[1] : "D:/TestImages/t1.bmp";
+    bool isColor = (argc > 2) && string(argv[2]) == "color";
+    SplitCriterion criterion = ((argc > 3) && string(argv[3]) == "deviation") ? splitOnMaxDeviation : splitOnVariance;
+
+    vector<double> thresholds;
+    for (int i = 4; i < argc; i++) {
+        thresholds.push_back(atof(argv[i]));
+    }
+    if (thresholds.empty()) {
+        thresholds = { 0, 4, 16, 64, 256, 1024 };
+    }
+
+    // create image object and load image
+    cv::Mat image = cv::imread(imagePath, isColor ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE);
+
+    if (image.empty()) {
+        cerr << "\nImage file corrupt or not found!" << endl;
+        // return -1 shows that the program ended with an error code -1
+        return -1;
+    }
+
+    int rows = image.rows;
+    int cols = image.cols;
+    size_t samples = static_cast<size_t>(rows) * cols * (isColor ? 3 : 1);
+
+    // contexts are reused across thresholds, so only the first run allocates
+    CodecContext grayCodec, grayDecoder;
+    ColorCodecContext colorCodec, colorDecoder;
+    vector<unsigned char> encoded, decoded, original(samples);
+
+    for (int i = 0; i < rows; i++) {
+        memcpy(&original[static_cast<size_t>(i) * cols * (isColor ? 3 : 1)], image.ptr(i), cols * (isColor ? 3 : 1));
+    }
+
+    cout << "Image: " << imagePath << " (" << rows << "x" << cols << ", " << (isColor ? "BGR" : "grayscale") << ", "
+        << samples << " bytes raw)" << endl;
+    cout << "Split on: " << (criterion == splitOnVariance ? "variance" : "max deviation") << endl << endl;
+
+    // ratio is the compression ratio, raw bytes per encoded byte
+    cout << setw(12) << "threshold" << setw(12) << "nodes" << setw(14) << "bytes" << setw(10) << "ratio" << setw(12) << "PSNR(dB)" << endl;
+
+    for (size_t t = 0; t < thresholds.size(); t++) {
+        LossyOptions options(criterion, thresholds[t]);
+        size_t nodes;
+        int decodedRows, decodedCols;
+        bool ok;
+
+        if (isColor) {
+            colorCodec.encode(original.data(), rows, cols, static_cast<ptrdiff_t>(cols) * 3, options, encoded);
+            nodes = colorCodec.tree(0).nodeCount() + colorCodec.tree(1).nodeCount() + colorCodec.tree(2).nodeCount();
+            ok = colorDecoder.decode(encoded.data(), encoded.size(), decoded, decodedRows, decodedCols);
+        }
+        else {
+            grayCodec.encodeLossy(ImageView(original.data(), rows, cols, cols), options, encoded);
+            nodes = grayCodec.tree().nodeCount();
+            ok = grayDecoder.decode(encoded.data(), encoded.size(), decoded, decodedRows, decodedCols);
+        }
+
+        if (!ok) {
+            cerr << "\nDecoding failed at threshold " << thresholds[t] << "!" << endl;
+            return -1;
+        }
+
+        double psnr = computePsnr(original.data(), decoded.data(), samples);
+
+        cout << setw(12) << thresholds[t] << setw(12) << nodes << setw(14) << encoded.size()
+            << setw(10) << fixed << setprecision(3) << static_cast<double>(samples) / encoded.size()
+            << setw(12) << setprecision(2) << psnr << defaultfloat << endl;
+    }
+
+    // terminate program
+    return 0;
+}
@@ -0,0 +1,224 @@
+/*
+    Description:    Implementation of the memory-mapped BMP reader (see mapped-bmp.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "mapped-bmp.h"
+#include "byte-order.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// sizes and offsets from the BMP file / info headers
+static const size_t fileHeaderSize = 14;
+static const size_t infoHeaderMinSize = 40;
+static const uint32_t compressionNone = 0;
+static const uint32_t compressionBitfields = 3;
+
+MappedBmp::MappedBmp() {
+    mapping = nullptr;
+    mappingSize = 0;
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#endif
+    memset(palette, 0, sizeof(palette));
+}
+
+MappedBmp::~MappedBmp() {
+    close();
+}
+
+bool MappedBmp::fail(const string& reason) {
+    close();
+    message = reason;
+    return false;
+}
+
+bool MappedBmp::open(const string& path) {
+    close();
+    message.clear();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return fail("file not found");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        return fail("empty file");
+    }
+    mappingSize = static_cast<size_t>(fileSize.QuadPart);
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr) {
+        return fail("file can't be mapped");
+    }
+
+    mapping = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (mapping == nullptr) {
+        return fail("file can't be mapped");
+    }
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return fail("file not found");
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        ::close(file);
+        return fail("empty file");
+    }
+    mappingSize = static_cast<size_t>(status.st_size);
+
+    void* address = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping keeps the file alive on its own
+    ::close(file);
+
+    if (address == MAP_FAILED) {
+        return fail("file can't be mapped");
+    }
+    mapping = static_cast<const unsigned char*>(address);
+#endif
+
+    return parse();
+}
+
+void MappedBmp::close() {
+#ifdef _WIN32
+    if (mapping != nullptr) {
+        UnmapViewOfFile(mapping);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mapping != nullptr) {
+        munmap(const_cast<unsigned char*>(mapping), mappingSize);
+    }
+#endif
+
+    mapping = nullptr;
+    mappingSize = 0;
+    imageView = ImageView();
+}
+
+bool MappedBmp::parse() {
+    if (mappingSize < fileHeaderSize + infoHeaderMinSize || mapping[0] != 'B' || mapping[1] != 'M') {
+        return fail("not a BMP file");
+    }
+
+    uint32_t pixelOffset = getInt(mapping + 10);
+    const unsigned char* info = mapping + fileHeaderSize;
+    uint32_t infoSize = getInt(info);
+
+    // the 12-byte OS/2 core header is not supported
+    if (infoSize < infoHeaderMinSize || fileHeaderSize + infoSize > mappingSize) {
+        return fail("unsupported BMP header");
+    }
+
+    int32_t width = static_cast<int32_t>(getInt(info + 4));
+    int32_t height = static_cast<int32_t>(getInt(info + 8));
+    uint16_t bitCount = getShort(info + 14);
+    uint32_t compression = getInt(info + 16);
+    uint32_t colorsUsed = getInt(info + 32);
+
+    // a negative height means the rows are stored top-down
+    bool topDown = height < 0;
+    long long rows = topDown ? -static_cast<long long>(height) : height;
+
+    if (width <= 0 || rows <= 0 || rows > INT32_MAX) {
+        return fail("invalid image dimensions");
+    }
+
+    PixelFormat format;
+    switch (bitCount) {
+    case 1: format = indexed1; break;
+    case 8: format = indexed8; break;
+    case 24: format = bgr24; break;
+    case 32: format = bgra32; break;
+    default: return fail("unsupported bit depth " + to_string(bitCount));
+    }
+
+    if (compression == compressionBitfields && bitCount == 32) {
+        // only the usual BGRA layout is read in place. the masks follow a 40-byte header and are
+        // part of the larger (v4 / v5) headers
+        size_t masksOffset = fileHeaderSize + infoHeaderMinSize;
+        if (masksOffset + 12 > mappingSize) {
+            return fail("truncated BMP header");
+        }
+        if (getInt(mapping + masksOffset) != 0x00FF0000 || getInt(mapping + masksOffset + 4) != 0x0000FF00 ||
+            getInt(mapping + masksOffset + 8) != 0x000000FF) {
+            return fail("unsupported BMP colour masks");
+        }
+    }
+    else if (compression != compressionNone) {
+        return fail("compressed BMP files are not supported");
+    }
+
+    // palette: blue, green, red, reserved per entry, right after the info header
+    if (format == indexed1 || format == indexed8) {
+        size_t maxColors = size_t(1) << bitCount;
+        size_t colors = (colorsUsed == 0 || colorsUsed > maxColors) ? maxColors : colorsUsed;
+        size_t paletteOffset = fileHeaderSize + infoSize;
+
+        if (paletteOffset + colors * 4 > mappingSize) {
+            return fail("truncated BMP palette");
+        }
+
+        memset(palette, 0, sizeof(palette));
+        for (size_t i = 0; i < colors; i++) {
+            palette[i] = static_cast<unsigned char>(ImageView::luma(mapping + paletteOffset + 4 * i));
+        }
+
+        // an 8-bit file whose palette maps every index to itself is plain greyscale, read it as
+        // such so the encoder takes the byte-per-pixel path
+        if (format == indexed8) {
+            bool identity = true;
+            for (int i = 0; i < 256 && identity; i++) {
+                identity = palette[i] == i;
+            }
+            if (identity) {
+                format = gray8;
+            }
+        }
+    }
+
+    // rows are padded to a multiple of 4 bytes
+    unsigned long long stride = ((static_cast<unsigned long long>(width) * bitCount + 31) / 32) * 4;
+    if (pixelOffset > mappingSize || stride * rows > mappingSize - pixelOffset) {
+        return fail("truncated BMP pixel data");
+    }
+
+    const unsigned char* pixels = mapping + pixelOffset;
+    ptrdiff_t rowStep = static_cast<ptrdiff_t>(stride);
+
+    // bottom-up files store the last row first: start at the last stored row and walk backwards
+    if (!topDown) {
+        pixels += (rows - 1) * stride;
+        rowStep = -rowStep;
+    }
+
+    imageView = ImageView(pixels, static_cast<int>(rows), width, rowStep, format, palette);
+    return true;
+}
@@ -0,0 +1,50 @@
+/*
+    Description:    Zero-copy BMP reader. The file is memory-mapped and its pixel rows are exposed in
+                    place through an ImageView, so the encoder reads pixels straight from the page cache
+                    instead of decoding into a cv::Mat and then copying into an int array.
+                    Handles bottom-up and top-down row order, row padding, 1 and 8-bit palettes and
+                    24 / 32-bit BGR(A) pixels (read back as luma).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "quadtree-codec.h"
+
+class MappedBmp {
+public:
+    MappedBmp();
+    ~MappedBmp();
+
+    MappedBmp(const MappedBmp&) = delete;
+    MappedBmp& operator=(const MappedBmp&) = delete;
+
+    // maps the file and checks its headers, returns false (with error() set) if it can't be read
+    bool open(const std::string& path);
+    void close();
+
+    // view over the mapped pixels, valid until close() or the next open()
+    const ImageView& view() const { return imageView; }
+
+    const std::string& error() const { return message; }
+
+private:
+    const unsigned char* mapping;
+    std::size_t mappingSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+    ImageView imageView;
+    unsigned char palette[256]; // grey level of every palette index
+    std::string message;
+
+    bool fail(const std::string& reason);
+    bool parse();
+};
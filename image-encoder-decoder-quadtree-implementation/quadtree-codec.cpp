@@ -0,0 +1,1125 @@
+/*
+    Description:    Implementation of the quadtree codec library (see quadtree-codec.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "quadtree-codec.h"
+#include "leaf-block.h"
+#include "byte-order.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+using namespace std;
+
+// ------------------------------------------------------------------
+// 2d linked list (run-length stage)
+// ------------------------------------------------------------------
+
+// default constructor
+LinkedList2d::LinkedList2d() {
+    data = 0;
+    head = nullptr;
+    right = nullptr;
+    down = nullptr;
+}
+
+// parameterized constructor
+LinkedList2d::LinkedList2d(int data) {
+    this->data = data;
+    head = nullptr;
+    right = nullptr;
+    down = nullptr;
+}
+
+LinkedList2d::~LinkedList2d() {
+    clear();
+}
+
+// free every node hanging off head
+void LinkedList2d::clear() {
+    LinkedList2d* ptrRow = head;
+
+    while (ptrRow != nullptr) {
+        LinkedList2d* nextRow = ptrRow->down;
+        LinkedList2d* ptrCol = ptrRow;
+
+        while (ptrCol != nullptr) {
+            LinkedList2d* next = ptrCol->right;
+            delete ptrCol;
+            ptrCol = next;
+        }
+        ptrRow = nextRow;
+    }
+    head = nullptr;
+}
+
+// appends a node holding data after ptr and returns it
+static LinkedList2d* appendNode(LinkedList2d* ptr, int data) {
+    ptr->right = new LinkedList2d(data);
+    return ptr->right;
+}
+
+void LinkedList2d::convertTo2dLL(const ImageView& image) {
+    clear();
+
+    if (image.rows == 0) {
+        return;
+    }
+
+    LinkedList2d** head = new LinkedList2d* [image.rows];
+    LinkedList2d* ptr = nullptr;
+
+    queue<int> blackIndexes;
+
+    for (int i = 0; i < image.rows; i++) {
+        head[i] = new LinkedList2d(i + 1); // head of each row is the row number
+        ptr = head[i]; // ptr points to the head of the row
+
+        // to check if the pixel is in black sequence or white sequence
+        bool isInBlack, isInWhite;
+        isInBlack = isInWhite = false;
+
+        // to store the starting and end indices of black and white sequences
+        int blackStartIndex, blackEndIndex;
+        int whiteStartIndex, whiteEndIndex;
+
+        // initially undefined
+        whiteStartIndex = whiteEndIndex = -1;
+        blackStartIndex = blackEndIndex = -1;
+
+        for (int j = 0; j < image.cols; j++) {
+            // if the pixel is white
+            if (image.pixel(i, j) == 255) {
+                if (isInWhite == false) {
+                    isInWhite = true;
+                    whiteStartIndex = j + 1;
+                }
+                whiteEndIndex = j + 1;
+
+                if (isInBlack == true) {
+                    blackIndexes.push(blackStartIndex);
+                    blackIndexes.push(blackEndIndex);
+
+                    isInBlack = false;
+                }
+            }
+
+            // if the pixel is black
+            else {
+                // stores black pixel sequence's start index
+                if (isInBlack == false) {
+                    isInBlack = true;
+                    blackStartIndex = j + 1;
+                }
+                blackEndIndex = j + 1;
+
+                if (isInWhite == true) {
+                    // stores white pixel sequence's start and end index
+                    ptr = appendNode(ptr, whiteStartIndex);
+                    ptr = appendNode(ptr, whiteEndIndex);
+
+                    isInWhite = false;
+                }
+            }
+        }
+
+        // if the last pixel is white
+        if (isInWhite == true) {
+            ptr = appendNode(ptr, whiteStartIndex);
+            ptr = appendNode(ptr, whiteEndIndex);
+        }
+
+        // -2 indicates the end of white pixel sequence
+        ptr = appendNode(ptr, -2);
+
+        // adds black pixel sequences to the linked list at the end of each row followed by -1
+        while (!blackIndexes.empty()) {
+            ptr = appendNode(ptr, blackIndexes.front());
+            blackIndexes.pop();
+
+            ptr = appendNode(ptr, blackIndexes.front());
+            blackIndexes.pop();
+        }
+
+        // if the last pixel is black
+        if (isInBlack == true) {
+            ptr = appendNode(ptr, blackStartIndex);
+            ptr = appendNode(ptr, blackEndIndex);
+        }
+
+        // -1 indicates the end of black pixel sequence
+        ptr = appendNode(ptr, -1);
+    }
+
+    // set down pointers of each rows head to the next row's head
+    for (int i = 0; i < (image.rows - 1); i++) {
+        head[i]->down = head[i + 1];
+    }
+
+    // set the head to point to the first row's head
+    this->head = head[0];
+
+    // free memory allocated to the array of head pointers
+    delete[] head;
+}
+
+// print 2d linked list
+void LinkedList2d::print2dLL(ostream& out) const {
+    LinkedList2d* ptrRow = this->head;
+
+    while (ptrRow != nullptr) {
+        LinkedList2d* ptrCol = ptrRow;
+
+        while (ptrCol != nullptr) {
+            out << ptrCol->data << " ";
+            ptrCol = ptrCol->right;
+        }
+        out << endl;
+        ptrRow = ptrRow->down;
+    }
+}
+
+// ------------------------------------------------------------------
+// node pool
+// ------------------------------------------------------------------
+
+NodePool::NodePool() {
+    used = 0;
+}
+
+NodePool::~NodePool() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        delete[] blocks[i];
+    }
+}
+
+TreeNode* NodePool::allocate() {
+    // grab a new block only when every existing one is in use
+    if (used == blocks.size() * blockSize) {
+        blocks.push_back(new TreeNode[blockSize]);
+    }
+
+    TreeNode* node = &blocks[used / blockSize][used % blockSize];
+    used++;
+    return node;
+}
+
+void NodePool::reset() {
+    used = 0;
+}
+
+// ------------------------------------------------------------------
+// quadtree
+// ------------------------------------------------------------------
+
+static size_t countNodes(const TreeNode* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    // a leaf block counts as the subtree it stands for
+    if (node->checkBlock) {
+        return leafBlockNodeCount(leafBlockShape(node->xEnd - node->xStart, node->yEnd - node->yStart), node->bits);
+    }
+
+    size_t count = 1;
+    for (int i = 0; i < 4; i++) {
+        count += countNodes(node->children[i]);
+    }
+    return count;
+}
+
+size_t QuadTree::nodeCount() const {
+    return countNodes(root);
+}
+
+// records written / read by the serializer, a leaf block is a single record
+static size_t countRecords(const TreeNode* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    size_t count = 1;
+    for (int i = 0; i < 4; i++) {
+        count += countRecords(node->children[i]);
+    }
+    return count;
+}
+
+// builds the TreeNodes a leaf block stands for into storage (leafBlockMaxNodes long), for the
+// places that need a node-by-node view (printing, node files)
+static TreeNode* expandLeafBlock(const TreeNode* block, const LeafBlockShape& shape, int index, TreeNode* storage, int& used) {
+    TreeNode* node = &storage[used++];
+    uint64_t covered = block->bits & shape.mask[index];
+
+    node->xStart = block->xStart + shape.xStart[index];
+    node->yStart = block->yStart + shape.yStart[index];
+    node->xEnd = block->xStart + shape.xEnd[index];
+    node->yEnd = block->yStart + shape.yEnd[index];
+    node->blackCount = popCount(covered);
+    node->checkBlock = false;
+    node->bits = 0;
+
+    for (int i = 0; i < 4; i++) {
+        node->children[i] = nullptr;
+    }
+
+    if (covered == 0 || covered == shape.mask[index]) {
+        node->checkLeaf = true;
+        node->color = (covered == 0) ? 255 : block->color;
+        return node;
+    }
+
+    node->checkLeaf = false;
+    node->color = -1; // grey color
+    for (int i = 0; i < 4; i++) {
+        if (shape.children[index][i] >= 0) {
+            node->children[i] = expandLeafBlock(block, shape, shape.children[index][i], storage, used);
+        }
+    }
+    return node;
+}
+
+static const TreeNode* expandLeafBlock(const TreeNode* block, TreeNode* storage) {
+    int used = 0;
+    return expandLeafBlock(block, leafBlockShape(block->xEnd - block->xStart, block->yEnd - block->yStart), 0, storage, used);
+}
+
+static void printNode(ostream& out, const TreeNode* node, const string& parentQuadrant) {
+    // quadrants for child nodes (nw, ne, sw, se)
+    static const char* const childQuadrants[4] = { "Top-Left", "Top-Right", "Bottom-Left", "Bottom-Right" };
+
+    if (node->checkBlock) {
+        TreeNode storage[leafBlockMaxNodes];
+        printNode(out, expandLeafBlock(node, storage), parentQuadrant);
+        return;
+    }
+
+    if (parentQuadrant.empty())
+        out << "Root Node -> ";
+    else
+        out << "Node " << "(" << parentQuadrant << ") -> ";
+
+    out << "Position: (" << node->xStart << ", " << node->yStart << ") - (" << node->xEnd << ", " << node->yEnd << ") " << "Color: " << node->color;
+    // print if node is leaf
+    if (node->checkLeaf) {
+        out << " ==> is a Leaf Node";
+    }
+
+    out << endl;
+
+    // recursively print the children nodes
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            printNode(out, node->children[i], childQuadrants[i]);
+        }
+    }
+}
+
+void QuadTree::printQuadTree(ostream& out) const {
+    if (root != nullptr) {
+        printNode(out, root, "");
+    }
+}
+
+// paints rows [top, bottom) x columns [left, right) of a leaf block straight from its bitboard,
+// pixels points at image pixel (originX, originY)
+static void paintLeafBlock(const TreeNode* node, int top, int left, int bottom, int right, unsigned char* pixels, ptrdiff_t stride, int originX, int originY) {
+    unsigned char color = static_cast<unsigned char>(node->color);
+
+    for (int i = top; i < bottom; i++) {
+        unsigned char* row = pixels + (i - originX) * stride - originY;
+        unsigned int rowBits = static_cast<unsigned int>(node->bits >> (8 * (i - node->xStart))) & 0xFF;
+
+        for (int j = left; j < right; j++) {
+            row[j] = ((rowBits >> (j - node->yStart)) & 1) ? color : 255;
+        }
+    }
+}
+
+static void paintNode(const TreeNode* node, unsigned char* pixels, ptrdiff_t stride) {
+    if (node->checkBlock) {
+        paintLeafBlock(node, node->xStart, node->yStart, node->xEnd, node->yEnd, pixels, stride, 0, 0);
+        return;
+    }
+
+    // if node is leaf fill its block with the color of the leaf
+    if (node->checkLeaf) {
+        for (int i = node->xStart; i < node->xEnd; i++) {
+            memset(pixels + i * stride + node->yStart, node->color, node->yEnd - node->yStart);
+        }
+        return;
+    }
+
+    // recursively call the function for the children nodes
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            paintNode(node->children[i], pixels, stride);
+        }
+    }
+}
+
+void QuadTree::quadTreeToImageArray(unsigned char* pixels, ptrdiff_t stride) const {
+    if (root != nullptr) {
+        paintNode(root, pixels, stride);
+    }
+}
+
+// paints the part of node that falls inside [xStart, xEnd) x [yStart, yEnd), subtrees outside
+// the region are skipped entirely
+static void paintRegion(const TreeNode* node, int xStart, int yStart, int xEnd, int yEnd, unsigned char* pixels, ptrdiff_t stride) {
+    if (node->xEnd <= xStart || node->xStart >= xEnd || node->yEnd <= yStart || node->yStart >= yEnd) {
+        return;
+    }
+
+    if (node->checkLeaf) {
+        int top = max(node->xStart, xStart), bottom = min(node->xEnd, xEnd);
+        int left = max(node->yStart, yStart), right = min(node->yEnd, yEnd);
+
+        if (node->checkBlock) {
+            paintLeafBlock(node, top, left, bottom, right, pixels, stride, xStart, yStart);
+            return;
+        }
+
+        for (int i = top; i < bottom; i++) {
+            memset(pixels + (i - xStart) * stride + (left - yStart), node->color, right - left);
+        }
+        return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            paintRegion(node->children[i], xStart, yStart, xEnd, yEnd, pixels, stride);
+        }
+    }
+}
+
+void QuadTree::renderRegion(int x, int y, int rows, int cols, unsigned char* pixels, ptrdiff_t stride) const {
+    if (root != nullptr) {
+        paintRegion(root, x, y, x + rows, y + cols, pixels, stride);
+    }
+}
+
+long long blockArea(const TreeNode* node) {
+    return static_cast<long long>(node->xEnd - node->xStart) * (node->yEnd - node->yStart);
+}
+
+// ------------------------------------------------------------------
+// region queries (answered from the blackCount aggregates, no decoding)
+// ------------------------------------------------------------------
+
+int QuadTree::colorAt(int x, int y) const {
+    const TreeNode* node = root;
+
+    if (node == nullptr || x < 0 || y < 0 || x >= rows || y >= cols) {
+        return -1;
+    }
+
+    // descend into the child whose block holds (x, y)
+    while (!node->checkLeaf) {
+        const TreeNode* next = nullptr;
+        for (int i = 0; i < 4 && next == nullptr; i++) {
+            const TreeNode* child = node->children[i];
+            if (child != nullptr && x >= child->xStart && x < child->xEnd && y >= child->yStart && y < child->yEnd) {
+                next = child;
+            }
+        }
+
+        if (next == nullptr) {
+            return -1;
+        }
+        node = next;
+    }
+
+    if (node->checkBlock) {
+        uint64_t bit = 1ULL << (8 * (x - node->xStart) + (y - node->yStart));
+        return (node->bits & bit) ? node->color : 255;
+    }
+    return node->color;
+}
+
+static long long countBlackInRegion(const TreeNode* node, int xStart, int yStart, int xEnd, int yEnd) {
+    int top = max(node->xStart, xStart), bottom = min(node->xEnd, xEnd);
+    int left = max(node->yStart, yStart), right = min(node->yEnd, yEnd);
+
+    // no overlap, or nothing black underneath
+    if (top >= bottom || left >= right || node->blackCount == 0) {
+        return 0;
+    }
+
+    // node entirely inside the region, its aggregate is the answer
+    if (top == node->xStart && bottom == node->xEnd && left == node->yStart && right == node->yEnd) {
+        return node->blackCount;
+    }
+
+    // a leaf block partially covered, count the bits under the covered part
+    if (node->checkBlock) {
+        return popCount(node->bits & leafBlockRegionMask(top - node->xStart, left - node->yStart, bottom - node->xStart, right - node->yStart));
+    }
+
+    // a black leaf partially covered
+    if (node->checkLeaf) {
+        return static_cast<long long>(bottom - top) * (right - left);
+    }
+
+    long long count = 0;
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            count += countBlackInRegion(node->children[i], xStart, yStart, xEnd, yEnd);
+        }
+    }
+    return count;
+}
+
+long long QuadTree::countBlack(int x, int y, int rows, int cols) const {
+    if (root == nullptr || rows <= 0 || cols <= 0) {
+        return 0;
+    }
+
+    // clip to the image in 64 bits, the rectangle may come straight from a client
+    long long xStart = max<long long>(x, 0), xEnd = min<long long>(static_cast<long long>(x) + rows, this->rows);
+    long long yStart = max<long long>(y, 0), yEnd = min<long long>(static_cast<long long>(y) + cols, this->cols);
+    if (xStart >= xEnd || yStart >= yEnd) {
+        return 0;
+    }
+    return countBlackInRegion(root, static_cast<int>(xStart), static_cast<int>(yStart), static_cast<int>(xEnd), static_cast<int>(yEnd));
+}
+
+static void growBox(int box[4], bool& found, int xStart, int yStart, int xEnd, int yEnd) {
+    if (!found) {
+        box[0] = xStart;
+        box[1] = yStart;
+        box[2] = xEnd;
+        box[3] = yEnd;
+        found = true;
+    }
+    else {
+        box[0] = min(box[0], xStart);
+        box[1] = min(box[1], yStart);
+        box[2] = max(box[2], xEnd);
+        box[3] = max(box[3], yEnd);
+    }
+}
+
+// grows box [0..3] = xStart, yStart, xEnd, yEnd to hold the black pixels under node
+static void growBlackBox(const TreeNode* node, int box[4], bool& found) {
+    if (node->blackCount == 0) {
+        return;
+    }
+
+    // the box already spans this block, nothing underneath can grow it
+    if (found && node->xStart >= box[0] && node->yStart >= box[1] && node->xEnd <= box[2] && node->yEnd <= box[3]) {
+        return;
+    }
+
+    // fully black block
+    if (node->blackCount == blockArea(node)) {
+        growBox(box, found, node->xStart, node->yStart, node->xEnd, node->yEnd);
+        return;
+    }
+
+    // leaf block: occupied rows are the non-zero bytes, occupied columns the bits of all rows or'ed together
+    if (node->checkBlock) {
+        int top = -1, bottom = 0;
+        unsigned int columns = 0;
+
+        for (int i = 0; i < leafBlockSize; i++) {
+            unsigned int rowBits = static_cast<unsigned int>(node->bits >> (8 * i)) & 0xFF;
+            if (rowBits != 0) {
+                if (top < 0) {
+                    top = i;
+                }
+                bottom = i + 1;
+                columns |= rowBits;
+            }
+        }
+
+        int left = 0, right = leafBlockSize;
+        while (!(columns & (1u << left))) {
+            left++;
+        }
+        while (!(columns & (1u << (right - 1)))) {
+            right--;
+        }
+
+        growBox(box, found, node->xStart + top, node->yStart + left, node->xStart + bottom, node->yStart + right);
+        return;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            growBlackBox(node->children[i], box, found);
+        }
+    }
+}
+
+bool QuadTree::blackBoundingBox(int& xStart, int& yStart, int& xEnd, int& yEnd) const {
+    int box[4] = { 0, 0, 0, 0 };
+    bool found = false;
+
+    if (root != nullptr) {
+        growBlackBox(root, box, found);
+    }
+
+    xStart = box[0];
+    yStart = box[1];
+    xEnd = box[2];
+    yEnd = box[3];
+    return found;
+}
+
+template<PixelFormat Format>
+static bool isHomogeneousAs(const ImageView& image, int x, int y, int rows, int cols) {
+    // stores the color of the first pixel
+    int color = ImageView::readPixel<Format>(image.data + x * image.stride, y, image.palette);
+
+    // checks if all the pixels in the block are of the same color
+    for (int i = x; i < (x + rows); i++) {
+        const unsigned char* row = image.data + i * image.stride;
+        for (int j = y; j < (y + cols); j++) {
+            if (ImageView::readPixel<Format>(row, j, image.palette) != color) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool isHomogeneous(const ImageView& image, int x, int y, int rows, int cols) {
+    switch (image.format) {
+    case gray8:
+        return isHomogeneousAs<gray8>(image, x, y, rows, cols);
+    case indexed8:
+        return isHomogeneousAs<indexed8>(image, x, y, rows, cols);
+    case indexed1:
+        return isHomogeneousAs<indexed1>(image, x, y, rows, cols);
+    case bgr24:
+        return isHomogeneousAs<bgr24>(image, x, y, rows, cols);
+    default:
+        return isHomogeneousAs<bgra32>(image, x, y, rows, cols);
+    }
+}
+
+// ------------------------------------------------------------------
+// codec context
+// ------------------------------------------------------------------
+
+// serialized format: "QTC3", rows, cols, record count, then every node in pre-order as
+// xStart, yStart, xEnd, yEnd, color (int32 little endian), blackCount (int64 little endian),
+// kind (1 byte: 0 internal, 1 leaf, 2 leaf block) and a 1 byte mask with bit i set when
+// children[i] follows. leaf blocks are followed by their bitboard (uint64 little endian).
+// older buffers are still read: "QTC2" has no leaf blocks, "QTC1" has no blackCount either
+// (it is recomputed when they are parsed)
+static const unsigned char formatMagic[4] = { 'Q', 'T', 'C', '3' };
+static const unsigned char formatMagicV2[4] = { 'Q', 'T', 'C', '2' };
+static const unsigned char formatMagicV1[4] = { 'Q', 'T', 'C', '1' };
+static const size_t headerSize = 16;
+static const size_t nodeRecordSize = 30;
+static const size_t nodeRecordSizeV1 = 22;
+static const size_t leafBlockBitsSize = 8;
+
+enum RecordKind { internalRecord = 0, leafRecord = 1, leafBlockRecord = 2 };
+
+// deepest tree a 2^31 x 2^31 image can produce, anything deeper is a corrupt input
+static const int maxDepth = 32;
+
+// header and node fields are stored as two's complement int32
+static int32_t getSignedInt(const unsigned char* in) {
+    return static_cast<int32_t>(getInt(in));
+}
+
+// position in a serialized buffer while it is being parsed
+struct CodecContext::ParseCursor {
+    const unsigned char* cursor;
+    const unsigned char* end;
+    size_t recordSize;
+    bool hasAggregates;
+    bool hasLeafBlocks;
+    long long records;
+};
+
+// block of child quadrant (0 nw, 1 ne, 2 sw, 3 se) of node as buildNode splits it, false if
+// that quadrant is empty
+static bool childQuadrant(const TreeNode* node, int quadrant, int& xStart, int& yStart, int& xEnd, int& yEnd) {
+    int xMid = node->xStart + (node->xEnd - node->xStart) / 2;
+    int yMid = node->yStart + (node->yEnd - node->yStart) / 2;
+
+    xStart = (quadrant < 2) ? node->xStart : xMid;
+    xEnd = (quadrant < 2) ? xMid : node->xEnd;
+    yStart = (quadrant % 2 == 0) ? node->yStart : yMid;
+    yEnd = (quadrant % 2 == 0) ? yMid : node->yEnd;
+
+    return xStart < xEnd && yStart < yEnd;
+}
+
+// children a split of node has, 0 for a single pixel (which is never split)
+static unsigned char childQuadrantMask(const TreeNode* node) {
+    if (node->xEnd - node->xStart == 1 && node->yEnd - node->yStart == 1) {
+        return 0;
+    }
+
+    unsigned char mask = 0;
+    int xStart, yStart, xEnd, yEnd;
+    for (int i = 0; i < 4; i++) {
+        if (childQuadrant(node, i, xStart, yStart, xEnd, yEnd)) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+// checks a node read from untrusted input. the root must cover the whole image and every other
+// node must be exactly the quadrant buildNode gives it, an internal node must have every
+// non-empty quadrant as a child and a leaf none, so the leaves tile the image exactly once and
+// rendering costs O(nodes + pixels). leaves must also hold a pixel value
+static bool isValidNode(const TreeNode* node, const TreeNode* parent, int quadrant, unsigned char childMask, int rows, int cols) {
+    if (parent == nullptr) {
+        if (node->xStart != 0 || node->yStart != 0 || node->xEnd != rows || node->yEnd != cols) {
+            return false;
+        }
+    }
+    else {
+        int xStart, yStart, xEnd, yEnd;
+        if (!childQuadrant(parent, quadrant, xStart, yStart, xEnd, yEnd) || node->xStart != xStart || node->yStart != yStart ||
+            node->xEnd != xEnd || node->yEnd != yEnd) {
+            return false;
+        }
+    }
+
+    if (!node->checkLeaf) {
+        return childMask != 0 && childMask == childQuadrantMask(node);
+    }
+    if (childMask != 0) {
+        return false;
+    }
+
+    // a leaf block is at most 8x8, its bits stay inside the block and its colour is not white
+    if (node->checkBlock) {
+        int blockRows = node->xEnd - node->xStart, blockCols = node->yEnd - node->yStart;
+        return blockRows <= leafBlockSize && blockCols <= leafBlockSize && node->color >= 0 && node->color < 255 &&
+            (node->bits & ~leafBlockRegionMask(0, 0, blockRows, blockCols)) == 0;
+    }
+    return node->color >= 0 && node->color <= 255;
+}
+
+// black pixels under a node: the whole block for a black leaf, the sum of the children otherwise
+long long computeBlackCount(const TreeNode* node) {
+    if (node->checkBlock) {
+        return popCount(node->bits);
+    }
+    if (node->checkLeaf) {
+        return (node->color != 255) ? blockArea(node) : 0;
+    }
+
+    long long count = 0;
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            count += node->children[i]->blackCount;
+        }
+    }
+    return count;
+}
+
+CodecContext::CodecContext() {
+}
+
+TreeNode* CodecContext::newNode(int color, int xStart, int yStart, int xEnd, int yEnd) {
+    TreeNode* node = pool.allocate();
+    node->color = color;
+    node->xStart = xStart;
+    node->yStart = yStart;
+    node->xEnd = xEnd;
+    node->yEnd = yEnd;
+    node->checkLeaf = true;
+    node->checkBlock = false;
+    node->bits = 0;
+    node->blackCount = 0;
+
+    // set all children to null
+    for (int i = 0; i < 4; i++) {
+        node->children[i] = nullptr;
+    }
+    return node;
+}
+
+// recursive function to build the quadtree of the block [xStart, xEnd) x [yStart, yEnd)
+// if the block is homogeneous the function creates a leaf node and returns it, otherwise
+// (i.e: grey colour, combination of black and white pixels) it creates a node and calls itself
+// recursively for each non-empty quadrant. odd sizes give the extra row / column to the
+// south / east quadrants, so images of any size are encoded without losing pixels.
+// blocks of at most 8x8 pixels holding white and one other colour end the recursion as a
+// single leaf-block record (see leaf-block.h)
+TreeNode* CodecContext::buildNode(const ImageView& image, int xStart, int yStart, int xEnd, int yEnd) {
+    int rows = xEnd - xStart;
+    int cols = yEnd - yStart;
+
+    TreeNode* node = newNode(image.pixel(xStart, yStart), xStart, yStart, xEnd, yEnd);
+    bool homogeneous = false;
+
+    if (rows <= leafBlockSize && cols <= leafBlockSize) {
+        int color;
+        uint64_t bits;
+
+        if (leafBlockPacker(image.format, rows, cols)(image, xStart, yStart, color, bits)) {
+            if (bits != 0 && bits != leafBlockRegionMask(0, 0, rows, cols)) {
+                node->checkBlock = true;
+                node->bits = bits;
+            }
+            node->color = color;
+            node->blackCount = computeBlackCount(node);
+            return node;
+        }
+        // two different non-white colours, split as usual
+    }
+    else {
+        homogeneous = isHomogeneous(image, xStart, yStart, rows, cols);
+    }
+
+    if (homogeneous == false) {
+        node->checkLeaf = false; // not a leaf node
+        node->color = -1; // grey color
+
+        int xMid = xStart + rows / 2;
+        int yMid = yStart + cols / 2;
+
+        // north-west child
+        if (xMid > xStart && yMid > yStart)
+            node->children[0] = buildNode(image, xStart, yStart, xMid, yMid);
+        // north-east child
+        if (xMid > xStart)
+            node->children[1] = buildNode(image, xStart, yMid, xMid, yEnd);
+        // south-west child
+        if (yMid > yStart)
+            node->children[2] = buildNode(image, xMid, yStart, xEnd, yMid);
+        // south-east child
+        node->children[3] = buildNode(image, xMid, yMid, xEnd, yEnd);
+    }
+
+    node->blackCount = computeBlackCount(node);
+    return node;
+}
+
+const QuadTree& CodecContext::buildQuadTree(const ImageView& image) {
+    pool.reset();
+
+    quadTree.rows = image.rows;
+    quadTree.cols = image.cols;
+    quadTree.root = nullptr;
+
+    if (image.rows > 0 && image.cols > 0) {
+        quadTree.root = buildNode(image, 0, 0, image.rows, image.cols);
+    }
+    return quadTree;
+}
+
+static void serializeNode(const TreeNode* node, vector<unsigned char>& out) {
+    putInt(out, static_cast<uint32_t>(node->xStart));
+    putInt(out, static_cast<uint32_t>(node->yStart));
+    putInt(out, static_cast<uint32_t>(node->xEnd));
+    putInt(out, static_cast<uint32_t>(node->yEnd));
+    putInt(out, static_cast<uint32_t>(node->color));
+    putLong(out, static_cast<uint64_t>(node->blackCount));
+    out.push_back(static_cast<unsigned char>(node->checkBlock ? leafBlockRecord : (node->checkLeaf ? leafRecord : internalRecord)));
+
+    unsigned char childMask = 0;
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            childMask |= 1 << i;
+        }
+    }
+    out.push_back(childMask);
+
+    if (node->checkBlock) {
+        putLong(out, node->bits);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr) {
+            serializeNode(node->children[i], out);
+        }
+    }
+}
+
+void CodecContext::serialize(vector<unsigned char>& out) const {
+    size_t nodes = countRecords(quadTree.root);
+
+    out.clear();
+    out.reserve(headerSize + nodes * (nodeRecordSize + leafBlockBitsSize));
+
+    out.insert(out.end(), formatMagic, formatMagic + 4);
+    putInt(out, static_cast<uint32_t>(quadTree.rows));
+    putInt(out, static_cast<uint32_t>(quadTree.cols));
+    putInt(out, static_cast<uint32_t>(nodes));
+
+    if (quadTree.root != nullptr) {
+        serializeNode(quadTree.root, out);
+    }
+}
+
+void CodecContext::encode(const ImageView& image, vector<unsigned char>& out) {
+    buildQuadTree(image);
+    serialize(out);
+}
+
+TreeNode* CodecContext::parseNode(ParseCursor& in, const TreeNode* parent, int quadrant, int depth) {
+    if (depth > maxDepth || static_cast<size_t>(in.end - in.cursor) < in.recordSize) {
+        return nullptr;
+    }
+
+    const unsigned char* record = in.cursor;
+    TreeNode* node = newNode(getSignedInt(record + 16), getSignedInt(record), getSignedInt(record + 4), getSignedInt(record + 8), getSignedInt(record + 12));
+
+    long long storedBlackCount = 0;
+    if (in.hasAggregates) {
+        storedBlackCount = static_cast<int64_t>(getLong(record + 20));
+        record += 8;
+    }
+    unsigned char kind = record[20];
+    unsigned char childMask = record[21];
+    in.cursor += in.recordSize;
+    in.records++;
+
+    if (kind > (in.hasLeafBlocks ? leafBlockRecord : leafRecord)) {
+        return nullptr;
+    }
+    node->checkLeaf = kind != internalRecord;
+
+    if (kind == leafBlockRecord) {
+        if (static_cast<size_t>(in.end - in.cursor) < leafBlockBitsSize || childMask != 0) {
+            return nullptr;
+        }
+        node->checkBlock = true;
+        node->bits = getLong(in.cursor);
+        in.cursor += leafBlockBitsSize;
+    }
+
+    if (!isValidNode(node, parent, quadrant, childMask, quadTree.rows, quadTree.cols)) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (childMask & (1 << i)) {
+            node->children[i] = parseNode(in, node, i, depth + 1);
+            if (node->children[i] == nullptr) {
+                return nullptr;
+            }
+        }
+    }
+
+    // aggregates are cheap to recompute, so stored ones are checked rather than trusted. a block
+    // can't hold more black pixels than it has pixels
+    node->blackCount = computeBlackCount(node);
+    if ((in.hasAggregates && node->blackCount != storedBlackCount) || node->blackCount > blockArea(node)) {
+        return nullptr;
+    }
+    return node;
+}
+
+bool CodecContext::parseQuadTree(const unsigned char* data, size_t size) {
+    pool.reset();
+    quadTree = QuadTree();
+
+    if (size < headerSize) {
+        return false;
+    }
+
+    ParseCursor in;
+    in.cursor = data + headerSize;
+    in.end = data + size;
+    in.records = 0;
+
+    if (memcmp(data, formatMagic, 4) == 0) {
+        in.recordSize = nodeRecordSize;
+        in.hasAggregates = true;
+        in.hasLeafBlocks = true;
+    }
+    else if (memcmp(data, formatMagicV2, 4) == 0) {
+        in.recordSize = nodeRecordSize;
+        in.hasAggregates = true;
+        in.hasLeafBlocks = false;
+    }
+    else if (memcmp(data, formatMagicV1, 4) == 0) {
+        in.recordSize = nodeRecordSizeV1;
+        in.hasAggregates = false;
+        in.hasLeafBlocks = false;
+    }
+    else {
+        return false;
+    }
+
+    int rows = getSignedInt(data + 4);
+    int cols = getSignedInt(data + 8);
+    int nodes = getSignedInt(data + 12);
+    if (rows < 0 || cols < 0 || nodes < 0 || static_cast<size_t>(nodes) > (size - headerSize) / in.recordSize) {
+        return false;
+    }
+    quadTree.rows = rows;
+    quadTree.cols = cols;
+
+    if (in.cursor == in.end) {
+        // empty image
+        return rows == 0 || cols == 0;
+    }
+
+    quadTree.root = parseNode(in, nullptr, 0, 0);
+    if (quadTree.root == nullptr || in.cursor != in.end || in.records != nodes) {
+        quadTree = QuadTree();
+        return false;
+    }
+    return true;
+}
+
+bool CodecContext::decode(const unsigned char* data, size_t size, vector<unsigned char>& pixels, int& rows, int& cols, long long maxPixels) {
+    if (!parseQuadTree(data, size)) {
+        return false;
+    }
+
+    // the dimensions come from the (untrusted) header, check them before allocating
+    if (static_cast<long long>(quadTree.rows) * quadTree.cols > maxPixels) {
+        return false;
+    }
+
+    rows = quadTree.rows;
+    cols = quadTree.cols;
+
+    // pixels not covered by any leaf stay black
+    pixels.assign(static_cast<size_t>(rows) * cols, 0);
+    quadTree.quadTreeToImageArray(pixels.data(), cols);
+    return true;
+}
+
+// write node information to separate files in pre-order (root.txt, node2.txt, node3.txt, ...)
+static bool writeNode(const TreeNode* node, const string& directory, int& nodeCount, bool isRoot) {
+    // node files have no leaf-block record, write the subtree it stands for
+    if (node->checkBlock) {
+        TreeNode storage[leafBlockMaxNodes];
+        return writeNode(expandLeafBlock(node, storage), directory, nodeCount, isRoot);
+    }
+
+    // create a file for each node
+    ofstream nodeFile;
+    if (isRoot)
+        nodeFile.open(directory + "/root.txt", ios::binary);
+    else
+        nodeFile.open(directory + "/node" + to_string(nodeCount++) + ".txt", ios::binary);
+
+    if (!nodeFile) {
+        return false;
+    }
+
+    // write node information to the file using binary mode
+    nodeFile.write((const char*)&node->xStart, sizeof(int));
+    nodeFile.write((const char*)&node->yStart, sizeof(int));
+    nodeFile.write((const char*)&node->xEnd, sizeof(int));
+    nodeFile.write((const char*)&node->yEnd, sizeof(int));
+    nodeFile.write((const char*)&node->color, sizeof(int));
+    nodeFile.write((const char*)&node->checkLeaf, sizeof(bool));
+
+    // store addresses of children nodes (only their null-ness is used by the reader)
+    for (int i = 0; i < 4; i++) {
+        nodeFile.write((const char*)&node->children[i], sizeof(TreeNode*));
+    }
+
+    nodeFile.close();
+
+    // recursively write the children nodes
+    for (int i = 0; i < 4; i++) {
+        if (node->children[i] != nullptr && !writeNode(node->children[i], directory, nodeCount, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CodecContext::writeNodeInfo(const string& directory) const {
+    if (quadTree.root == nullptr) {
+        return false;
+    }
+
+    // nodes starting after the root node (root node is 1)
+    int nodeCount = 2;
+    return writeNode(quadTree.root, directory, nodeCount, true);
+}
+
+// using binary file handling read the information stored in files
+TreeNode* CodecContext::readNode(const string& directory, int& nodeCount, const TreeNode* parent, int quadrant, int depth) {
+    if (depth > maxDepth) {
+        return nullptr;
+    }
+
+    ifstream nodeFile;
+    if (parent == nullptr)
+        nodeFile.open(directory + "/root.txt", ios::binary);
+    else
+        nodeFile.open(directory + "/node" + to_string(nodeCount++) + ".txt", ios::binary);
+
+    TreeNode* node = newNode(0, 0, 0, 0, 0);
+
+    nodeFile.read((char*)&node->xStart, sizeof(int));
+    nodeFile.read((char*)&node->yStart, sizeof(int));
+    nodeFile.read((char*)&node->xEnd, sizeof(int));
+    nodeFile.read((char*)&node->yEnd, sizeof(int));
+    nodeFile.read((char*)&node->color, sizeof(int));
+    nodeFile.read((char*)&node->checkLeaf, sizeof(bool));
+
+    TreeNode* childAddress[4];
+    for (int i = 0; i < 4; i++) {
+        nodeFile.read((char*)&childAddress[i], sizeof(TreeNode*));
+    }
+
+    if (!nodeFile) {
+        return nullptr;
+    }
+    nodeFile.close();
+
+    // the root defines the image size
+    if (parent == nullptr) {
+        quadTree.rows = node->xEnd;
+        quadTree.cols = node->yEnd;
+    }
+    unsigned char childMask = 0;
+    for (int i = 0; i < 4; i++) {
+        if (childAddress[i] != nullptr) {
+            childMask |= 1 << i;
+        }
+    }
+    if (!isValidNode(node, parent, quadrant, childMask, quadTree.rows, quadTree.cols)) {
+        return nullptr;
+    }
+
+    // if child is not null (i.e. node is not leaf) read it from the next file
+    for (int i = 0; i < 4; i++) {
+        if (childAddress[i] != nullptr) {
+            node->children[i] = readNode(directory, nodeCount, node, i, depth + 1);
+            if (node->children[i] == nullptr) {
+                return nullptr;
+            }
+        }
+    }
+
+    // node files predate the aggregates, so they are always recomputed
+    node->blackCount = computeBlackCount(node);
+    if (node->blackCount > blockArea(node)) {
+        return nullptr;
+    }
+    return node;
+}
+
+bool CodecContext::readNodeInfo(const string& directory) {
+    pool.reset();
+    quadTree = QuadTree();
+
+    int nodeCount = 2;
+    quadTree.root = readNode(directory, nodeCount, nullptr, 0, 0);
+    if (quadTree.root == nullptr) {
+        quadTree = QuadTree();
+        return false;
+    }
+    return true;
+}
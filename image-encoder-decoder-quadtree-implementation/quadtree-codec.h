@@ -0,0 +1,263 @@
+/*
+    Description:    Quadtree image codec library shared by the encoder and decoder programs. All state
+                    lives in an explicit CodecContext, so one process can encode / decode any number of
+                    images, and several threads can work at once as long as each uses its own context.
+
+    Note:           This file has no OpenCV dependency, images are passed around as plain pixel buffers.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// how the pixels of an ImageView are stored. every format reads back as 8-bit grey levels
+enum PixelFormat {
+    gray8,    // one grey level per byte
+    indexed8, // one palette index per byte
+    indexed1, // eight palette indices per byte, most significant bit first
+    bgr24,    // blue, green, red bytes, read back as luma
+    bgra32    // blue, green, red, alpha bytes, read back as luma
+};
+
+// read-only view over pixels owned by the caller (e.g. a cv::Mat, a plain buffer or a memory-mapped
+// BMP file). 255 is white, anything else is treated as black by the run-length stage
+struct ImageView {
+    const unsigned char* data; // first byte of row 0
+    int rows, cols;
+    std::ptrdiff_t stride; // bytes between the starts of two consecutive rows, negative for bottom-up images
+    PixelFormat format;
+    const unsigned char* palette; // grey level of every palette index for the indexed formats
+
+    ImageView() {
+        data = nullptr;
+        rows = cols = 0;
+        stride = 0;
+        format = gray8;
+        palette = nullptr;
+    }
+
+    ImageView(const unsigned char* data, int rows, int cols, std::ptrdiff_t stride) {
+        this->data = data;
+        this->rows = rows;
+        this->cols = cols;
+        this->stride = stride;
+        format = gray8;
+        palette = nullptr;
+    }
+
+    ImageView(const unsigned char* data, int rows, int cols, std::ptrdiff_t stride, PixelFormat format, const unsigned char* palette) {
+        this->data = data;
+        this->rows = rows;
+        this->cols = cols;
+        this->stride = stride;
+        this->format = format;
+        this->palette = palette;
+    }
+
+    // grey level of pixel j of a row stored in Format. loops over a block are instantiated once
+    // per format, so the format is not switched on for every pixel
+    template<PixelFormat Format>
+    static int readPixel(const unsigned char* row, int j, const unsigned char* palette) {
+        switch (Format) {
+        case gray8:
+            return row[j];
+        case indexed8:
+            return palette[row[j]];
+        case indexed1:
+            return palette[(row[j >> 3] >> (7 - (j & 7))) & 1];
+        case bgr24:
+            return luma(row + 3 * j);
+        default:
+            return luma(row + 4 * j);
+        }
+    }
+
+    int pixel(int i, int j) const {
+        const unsigned char* row = data + i * stride;
+
+        switch (format) {
+        case gray8:
+            return readPixel<gray8>(row, j, palette);
+        case indexed8:
+            return readPixel<indexed8>(row, j, palette);
+        case indexed1:
+            return readPixel<indexed1>(row, j, palette);
+        case bgr24:
+            return readPixel<bgr24>(row, j, palette);
+        default:
+            return readPixel<bgra32>(row, j, palette);
+        }
+    }
+
+    // same weights and rounding as OpenCV's BGR to grey conversion
+    static int luma(const unsigned char* bgr) {
+        return (bgr[0] * 1868 + bgr[1] * 9617 + bgr[2] * 4899 + 8192) >> 14;
+    }
+};
+
+// 2d linked list holding the run-length form of the image (white runs, -2, black runs, -1 per row)
+class LinkedList2d {
+public:
+    int data;
+    LinkedList2d* head;
+    LinkedList2d* right;
+    LinkedList2d* down;
+
+    LinkedList2d();
+    LinkedList2d(int data);
+    ~LinkedList2d();
+
+    void convertTo2dLL(const ImageView& image);
+    void print2dLL(std::ostream& out) const;
+    void clear();
+};
+
+// treenode
+struct TreeNode {
+    int color;
+    int xStart, yStart, xEnd, yEnd;
+
+    bool checkLeaf;
+
+    // number of black (non-white) pixels in the block, lets region queries skip whole subtrees
+    long long blackCount;
+
+    // leaf-block record (see leaf-block.h): a leaf of at most 8x8 pixels whose bits are set where the
+    // pixel has color and clear where it is white, it stands for the subtree the bits describe
+    bool checkBlock;
+    unsigned long long bits;
+
+    // children of the node (nw, ne, sw, se), null when the quadrant is empty or the node is a leaf
+    TreeNode* children[4];
+};
+
+// hands out TreeNodes from large blocks, reset() recycles every node without returning the memory
+class NodePool {
+public:
+    NodePool();
+    ~NodePool();
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    TreeNode* allocate();
+    void reset();
+
+    std::size_t size() const { return used; }
+
+private:
+    static const std::size_t blockSize = 4096;
+
+    std::vector<TreeNode*> blocks;
+    std::size_t used;
+};
+
+// quadtree of an image, nodes are owned by the NodePool of the context that built it
+class QuadTree {
+public:
+    TreeNode* root;
+    int rows, cols;
+
+    QuadTree() {
+        root = nullptr;
+        rows = cols = 0;
+    }
+
+    // number of nodes in the tree, leaf blocks count as the subtree they stand for
+    std::size_t nodeCount() const;
+
+    // print quad tree *__FOR__DEBUGGING__PURPOSES__*
+    void printQuadTree(std::ostream& out) const;
+
+    // paint the leaves into a row-major pixel buffer of rows x cols (stride in bytes)
+    void quadTreeToImageArray(unsigned char* pixels, std::ptrdiff_t stride) const;
+
+    // paint only the region [x, x + rows) x [y, y + cols) into pixels, pixels[0] is image pixel (x, y).
+    // the region must lie inside the image
+    void renderRegion(int x, int y, int rows, int cols, unsigned char* pixels, std::ptrdiff_t stride) const;
+
+    // colour of pixel (x, y) in O(depth), -1 if it lies outside the image
+    int colorAt(int x, int y) const;
+
+    // number of black pixels in [x, x + rows) x [y, y + cols), only nodes the rectangle partially
+    // covers are descended into. the rectangle is clipped to the image
+    long long countBlack(int x, int y, int rows, int cols) const;
+
+    // smallest block [xStart, xEnd) x [yStart, yEnd) holding every black pixel, false if there are none
+    bool blackBoundingBox(int& xStart, int& yStart, int& xEnd, int& yEnd) const;
+};
+
+struct LossyOptions;
+
+// largest image decode() renders unless the caller passes its own limit. the header of a tiny
+// (possibly hostile) buffer can claim up to 2^31 x 2^31 pixels
+const long long defaultMaxDecodePixels = 1LL << 30;
+
+// per-thread codec state: the node pool and scratch buffers are reused by every call, so a
+// long-running worker encodes / decodes without reallocating once it has warmed up.
+// a single context must not be used by two threads at the same time
+class CodecContext {
+public:
+    CodecContext();
+
+    CodecContext(const CodecContext&) = delete;
+    CodecContext& operator=(const CodecContext&) = delete;
+
+    // build the quadtree of an image, the tree stays valid until the next call on this context
+    const QuadTree& buildQuadTree(const ImageView& image);
+
+    // build the quadtree and serialize it into out (out is cleared first, its capacity is reused)
+    void encode(const ImageView& image, std::vector<unsigned char>& out);
+
+    // lossy mode (see lossy-codec.h): blocks within options.threshold of uniform become leaves
+    // holding their mean colour
+    const QuadTree& buildLossyQuadTree(const ImageView& image, const LossyOptions& options);
+    void encodeLossy(const ImageView& image, const LossyOptions& options, std::vector<unsigned char>& out);
+
+    // parse a serialized quadtree, returns false if the buffer is truncated or corrupt
+    bool parseQuadTree(const unsigned char* data, std::size_t size);
+
+    // parse a serialized quadtree and render it into pixels (rows * cols bytes, row-major). returns
+    // false without allocating if the header claims more than maxPixels pixels
+    bool decode(const unsigned char* data, std::size_t size, std::vector<unsigned char>& pixels, int& rows, int& cols,
+        long long maxPixels = defaultMaxDecodePixels);
+
+    // write / read the current tree as one file per node (root.txt, node2.txt, ...) in directory
+    bool writeNodeInfo(const std::string& directory) const;
+    bool readNodeInfo(const std::string& directory);
+
+    // serialize the current tree into out
+    void serialize(std::vector<unsigned char>& out) const;
+
+    const QuadTree& tree() const { return quadTree; }
+
+private:
+    NodePool pool;
+    QuadTree quadTree;
+
+    // integral images of the pixels and their squares for the lossy mode, reused between calls
+    std::vector<unsigned long long> sums, squaredSums;
+
+    TreeNode* newNode(int color, int xStart, int yStart, int xEnd, int yEnd);
+    TreeNode* buildNode(const ImageView& image, int xStart, int yStart, int xEnd, int yEnd);
+    TreeNode* buildLossyNode(const ImageView& image, const LossyOptions& options, int xStart, int yStart, int xEnd, int yEnd);
+    struct ParseCursor;
+
+    TreeNode* parseNode(ParseCursor& in, const TreeNode* parent, int quadrant, int depth);
+    TreeNode* readNode(const std::string& directory, int& nodeCount, const TreeNode* parent, int quadrant, int depth);
+};
+
+// number of pixels in the block of node
+long long blockArea(const TreeNode* node);
+
+// black pixels under a node, from its bits or colour if it is a leaf and its children otherwise
+long long computeBlackCount(const TreeNode* node);
+
+// true if every pixel of the block [x, x + rows) x [y, y + cols) has the same value
+bool isHomogeneous(const ImageView& image, int x, int y, int rows, int cols);
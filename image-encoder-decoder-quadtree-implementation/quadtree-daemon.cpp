@@ -0,0 +1,560 @@
+/*
+    Description:    Long-running local encode / decode service. It listens on a Unix domain socket,
+                    keeps parsed quadtrees in memory and serves encode, full-decode and tile-decode
+                    requests, so viewers don't pay for process startup and tree parsing on every
+                    request. Recently rendered tiles are kept in a size-bounded LRU cache.
+
+    Protocol:       Every request is one text line, optionally followed by a binary payload. Every
+                    reply is "OK ..." or "ERR <message>", optionally followed by a binary payload.
+
+                    LOAD <name> <bytes>\n<serialized tree>     -> OK <rows> <cols> <nodes>
+                    ENCODE <name> <rows> <cols>\n<pixels>       -> OK <bytes>\n<serialized tree>
+                    DECODE <name>                               -> OK <rows> <cols>\n<pixels>
+                    TILE <name> <x> <y> <rows> <cols>           -> OK <rows> <cols>\n<pixels>
+                    PIXEL <name> <x> <y>                        -> OK <color>
+                    COUNT <name> <x> <y> <rows> <cols>          -> OK <black pixels>
+                    BBOX <name>                                 -> OK <xStart> <yStart> <xEnd> <yEnd> | OK none
+                    UNLOAD <name>                               -> OK
+                    STATS                                       -> OK <lines>\n<lines of "key value">
+
+                    Pixels are 8-bit grayscale, row-major. Coordinates and sizes must lie in
+                    [0, 2^31 - 1] and images are limited to 2^28 pixels. Tiles are clipped to the
+                    image. Encoded images stay loaded under their name, just like LOADed ones. PIXEL,
+                    COUNT and BBOX are answered from the tree's aggregates without decoding.
+
+    Usage:          quadtree-daemon [socket path] [tile cache size in MB]
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+// headers
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET socket_t;
+#define closeSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int socket_t;
+#define closeSocket close
+#define INVALID_SOCKET (-1)
+#endif
+
+#include "quadtree-codec.h"
+#include "tile-cache.h"
+
+// namespaces
+using namespace std;
+
+// largest image (in pixels) or serialized tree (in bytes) the daemon accepts
+static const long long maxPixels = 1LL << 28;
+
+// request fields are read as long long, anything outside [0, INT_MAX] is rejected before any
+// arithmetic is done on it
+static bool isValidField(long long value) {
+    return value >= 0 && value <= INT_MAX;
+}
+
+// a loaded image: the context owns the parsed tree and its nodes. connection threads hold a
+// shared_ptr while rendering, so an image can be unloaded or replaced at any time
+struct LoadedImage {
+    shared_ptr<const CodecContext> codec;
+    unsigned long long generation;
+};
+
+class ImageStore {
+public:
+    ImageStore() {
+        nextGeneration = 1;
+    }
+
+    // stores codec under name, replacing any older image of that name
+    void put(const string& name, shared_ptr<const CodecContext> codec) {
+        lock_guard<mutex> guard(lock);
+        LoadedImage& image = images[name];
+        image.codec = codec;
+        image.generation = nextGeneration++;
+    }
+
+    bool get(const string& name, LoadedImage& image) const {
+        lock_guard<mutex> guard(lock);
+        auto found = images.find(name);
+        if (found == images.end()) {
+            return false;
+        }
+        image = found->second;
+        return true;
+    }
+
+    bool erase(const string& name) {
+        lock_guard<mutex> guard(lock);
+        return images.erase(name) != 0;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        return images.size();
+    }
+
+private:
+    mutable mutex lock;
+    unordered_map<string, LoadedImage> images;
+    unsigned long long nextGeneration;
+};
+
+// request counters and latency per command
+class RequestStats {
+public:
+    enum Command { load, encode, decode, tile, query, unload, stats, commandCount };
+
+    RequestStats() {
+        for (int i = 0; i < commandCount; i++) {
+            count[i] = 0;
+            totalMicros[i] = 0;
+            maxMicros[i] = 0;
+        }
+    }
+
+    void record(Command command, long long micros) {
+        lock_guard<mutex> guard(lock);
+        count[command]++;
+        totalMicros[command] += micros;
+        maxMicros[command] = max(maxMicros[command], micros);
+    }
+
+    void print(ostream& out) const {
+        static const char* const names[commandCount] = { "load", "encode", "decode", "tile", "query", "unload", "stats" };
+
+        lock_guard<mutex> guard(lock);
+        for (int i = 0; i < commandCount; i++) {
+            out << names[i] << ".count " << count[i] << "\n";
+            out << names[i] << ".avg_us " << (count[i] ? totalMicros[i] / count[i] : 0) << "\n";
+            out << names[i] << ".max_us " << maxMicros[i] << "\n";
+        }
+    }
+
+private:
+    mutable mutex lock;
+    long long count[commandCount];
+    long long totalMicros[commandCount];
+    long long maxMicros[commandCount];
+};
+
+// buffered reads / writes on a connected socket
+class Connection {
+public:
+    Connection(socket_t socket) {
+        this->socket = socket;
+        begin = end = 0;
+    }
+
+    ~Connection() {
+        closeSocket(socket);
+    }
+
+    // reads one line without its '\n', returns false when the peer hung up
+    bool readLine(string& line) {
+        line.clear();
+        while (true) {
+            if (begin == end && !fill()) {
+                return false;
+            }
+
+            char* newline = (char*)memchr(buffer + begin, '\n', end - begin);
+            if (newline != nullptr) {
+                line.append(buffer + begin, newline);
+                begin = newline - buffer + 1;
+                return true;
+            }
+            line.append(buffer + begin, buffer + end);
+            begin = end;
+
+            // a request line is never this long, the peer is not speaking our protocol
+            if (line.size() > 4096) {
+                return false;
+            }
+        }
+    }
+
+    bool readBytes(unsigned char* data, size_t size) {
+        while (size > 0) {
+            if (begin == end && !fill()) {
+                return false;
+            }
+
+            size_t chunk = min(size, end - begin);
+            memcpy(data, buffer + begin, chunk);
+            begin += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+        return true;
+    }
+
+    bool write(const void* data, size_t size) {
+        const char* cursor = (const char*)data;
+        while (size > 0) {
+            int chunk = (int)min(size, (size_t)1 << 20);
+            int sent = (int)send(socket, cursor, chunk, 0);
+            if (sent <= 0) {
+                return false;
+            }
+            cursor += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool write(const string& text) {
+        return write(text.data(), text.size());
+    }
+
+private:
+    socket_t socket;
+    char buffer[65536];
+    size_t begin, end;
+
+    bool fill() {
+        int received = (int)recv(socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        begin = 0;
+        end = received;
+        return true;
+    }
+};
+
+class Daemon {
+public:
+    Daemon(size_t cacheBytes) : cache(cacheBytes) {
+    }
+
+    // serves requests on a connection until the peer hangs up or breaks the protocol
+    void serve(socket_t socket) {
+        Connection connection(socket);
+        string line;
+
+        while (connection.readLine(line)) {
+            // a request that can't be allocated must only cost its own connection, an exception
+            // escaping a detached thread would take the whole daemon down
+            try {
+                if (!handle(connection, line)) {
+                    return;
+                }
+            }
+            catch (const bad_alloc&) {
+                connection.write("ERR out of memory\n");
+                return;
+            }
+            catch (const length_error&) {
+                connection.write("ERR out of memory\n");
+                return;
+            }
+        }
+    }
+
+private:
+    ImageStore images;
+    TileCache cache;
+    RequestStats requestStats;
+
+    // returns false when the connection must be dropped
+    bool handle(Connection& connection, const string& line) {
+        istringstream request(line);
+        string command;
+        request >> command;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        RequestStats::Command kind;
+        bool alive;
+
+        if (command == "LOAD") {
+            kind = RequestStats::load;
+            alive = handleLoad(connection, request);
+        }
+        else if (command == "ENCODE") {
+            kind = RequestStats::encode;
+            alive = handleEncode(connection, request);
+        }
+        else if (command == "DECODE") {
+            kind = RequestStats::decode;
+            alive = handleTile(connection, request, true);
+        }
+        else if (command == "TILE") {
+            kind = RequestStats::tile;
+            alive = handleTile(connection, request, false);
+        }
+        else if (command == "PIXEL" || command == "COUNT" || command == "BBOX") {
+            kind = RequestStats::query;
+            alive = handleQuery(connection, request, command);
+        }
+        else if (command == "UNLOAD") {
+            kind = RequestStats::unload;
+            alive = handleUnload(connection, request);
+        }
+        else if (command == "STATS") {
+            kind = RequestStats::stats;
+            alive = handleStats(connection);
+        }
+        else {
+            return connection.write("ERR unknown command\n");
+        }
+
+        long long micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        requestStats.record(kind, micros);
+        return alive;
+    }
+
+    void store(const string& name, shared_ptr<const CodecContext> codec) {
+        images.put(name, codec);
+        cache.eraseImage(name);
+    }
+
+    bool handleLoad(Connection& connection, istringstream& request) {
+        string name;
+        long long size;
+        if (!(request >> name >> size) || size < 0 || size > maxPixels) {
+            // the payload size is unknown, so the stream can't be resynchronized
+            connection.write("ERR usage: LOAD <name> <bytes>\n");
+            return false;
+        }
+
+        vector<unsigned char> data(size);
+        if (!connection.readBytes(data.data(), data.size())) {
+            return false;
+        }
+
+        shared_ptr<CodecContext> codec = make_shared<CodecContext>();
+        if (!codec->parseQuadTree(data.data(), data.size())) {
+            return connection.write("ERR corrupt quadtree\n");
+        }
+
+        // a few bytes can describe a huge image, which DECODE would then have to allocate
+        const QuadTree& tree = codec->tree();
+        if (static_cast<long long>(tree.rows) * tree.cols > maxPixels) {
+            return connection.write("ERR image too large\n");
+        }
+
+        string reply = "OK " + to_string(tree.rows) + " " + to_string(tree.cols) + " " + to_string(tree.nodeCount()) + "\n";
+        store(name, codec);
+        return connection.write(reply);
+    }
+
+    bool handleEncode(Connection& connection, istringstream& request) {
+        string name;
+        long long rows, cols;
+        if (!(request >> name >> rows >> cols) || !isValidField(rows) || !isValidField(cols) || rows * cols > maxPixels) {
+            connection.write("ERR usage: ENCODE <name> <rows> <cols>\n");
+            return false;
+        }
+
+        vector<unsigned char> pixels(rows * cols);
+        if (!connection.readBytes(pixels.data(), pixels.size())) {
+            return false;
+        }
+
+        shared_ptr<CodecContext> codec = make_shared<CodecContext>();
+        vector<unsigned char> encoded;
+        codec->encode(ImageView(pixels.data(), (int)rows, (int)cols, (ptrdiff_t)cols), encoded);
+        store(name, codec);
+
+        return connection.write("OK " + to_string(encoded.size()) + "\n") && connection.write(encoded.data(), encoded.size());
+    }
+
+    bool handleTile(Connection& connection, istringstream& request, bool wholeImage) {
+        string name;
+        long long x = 0, y = 0, rows = 0, cols = 0;
+        if (!(request >> name) || (!wholeImage && !(request >> x >> y >> rows >> cols))) {
+            return connection.write(wholeImage ? "ERR usage: DECODE <name>\n" : "ERR usage: TILE <name> <x> <y> <rows> <cols>\n");
+        }
+        if (!isValidField(x) || !isValidField(y) || !isValidField(rows) || !isValidField(cols)) {
+            return connection.write("ERR tile fields must be in [0, " + to_string(INT_MAX) + "]\n");
+        }
+
+        LoadedImage image;
+        if (!images.get(name, image)) {
+            return connection.write("ERR no such image\n");
+        }
+
+        const QuadTree& tree = image.codec->tree();
+        if (wholeImage) {
+            rows = tree.rows;
+            cols = tree.cols;
+        }
+
+        // clip the tile to the image
+        long long xEnd = min(x + rows, (long long)tree.rows), yEnd = min(y + cols, (long long)tree.cols);
+        x = max(x, 0LL);
+        y = max(y, 0LL);
+        rows = max(xEnd - x, 0LL);
+        cols = max(yEnd - y, 0LL);
+
+        if (rows * cols > maxPixels) {
+            return connection.write("ERR tile too large\n");
+        }
+
+        TileKey key = { name, image.generation, (int)x, (int)y, (int)rows, (int)cols };
+        TilePixels pixels = cache.find(key);
+
+        if (pixels == nullptr) {
+            shared_ptr<vector<unsigned char>> rendered = make_shared<vector<unsigned char>>(rows * cols, 0);
+            tree.renderRegion((int)x, (int)y, (int)rows, (int)cols, rendered->data(), (ptrdiff_t)cols);
+            pixels = rendered;
+            cache.insert(key, pixels);
+
+            // the image may have been replaced or unloaded while the tile rendered. its tiles were
+            // erased before this insert or the change is visible now, so a stale tile never lingers
+            LoadedImage current;
+            if (!images.get(name, current) || current.generation != image.generation) {
+                cache.erase(key);
+            }
+        }
+
+        return connection.write("OK " + to_string(rows) + " " + to_string(cols) + "\n") && connection.write(pixels->data(), pixels->size());
+    }
+
+    bool handleQuery(Connection& connection, istringstream& request, const string& command) {
+        string name;
+        if (!(request >> name)) {
+            return connection.write("ERR usage: " + command + " <name> ...\n");
+        }
+
+        LoadedImage image;
+        if (!images.get(name, image)) {
+            return connection.write("ERR no such image\n");
+        }
+        const QuadTree& tree = image.codec->tree();
+
+        if (command == "PIXEL") {
+            int x, y;
+            if (!(request >> x >> y)) {
+                return connection.write("ERR usage: PIXEL <name> <x> <y>\n");
+            }
+            int color = tree.colorAt(x, y);
+            return connection.write(color < 0 ? string("ERR outside the image\n") : "OK " + to_string(color) + "\n");
+        }
+
+        if (command == "COUNT") {
+            int x, y, rows, cols;
+            if (!(request >> x >> y >> rows >> cols)) {
+                return connection.write("ERR usage: COUNT <name> <x> <y> <rows> <cols>\n");
+            }
+            return connection.write("OK " + to_string(tree.countBlack(x, y, rows, cols)) + "\n");
+        }
+
+        int xStart, yStart, xEnd, yEnd;
+        if (!tree.blackBoundingBox(xStart, yStart, xEnd, yEnd)) {
+            return connection.write("OK none\n");
+        }
+        return connection.write("OK " + to_string(xStart) + " " + to_string(yStart) + " " + to_string(xEnd) + " " + to_string(yEnd) + "\n");
+    }
+
+    bool handleUnload(Connection& connection, istringstream& request) {
+        string name;
+        if (!(request >> name)) {
+            return connection.write("ERR usage: UNLOAD <name>\n");
+        }
+
+        if (!images.erase(name)) {
+            return connection.write("ERR no such image\n");
+        }
+        cache.eraseImage(name);
+        return connection.write("OK\n");
+    }
+
+    bool handleStats(Connection& connection) {
+        TileCacheStats tiles = cache.stats();
+        ostringstream out;
+
+        out << "images " << images.size() << "\n";
+        out << "cache.hits " << tiles.hits << "\n";
+        out << "cache.misses " << tiles.misses << "\n";
+        out << "cache.evictions " << tiles.evictions << "\n";
+        out << "cache.entries " << tiles.entries << "\n";
+        out << "cache.bytes " << tiles.bytes << "\n";
+        out << "cache.capacity " << tiles.capacity << "\n";
+        requestStats.print(out);
+
+        string text = out.str();
+        return connection.write("OK " + to_string(count(text.begin(), text.end(), '\n')) + "\n") && connection.write(text);
+    }
+};
+
+// driver code
+int main(int argc, char* argv[]) {
+    string socketPath = (argc > 1) ? argv[1] : "/tmp/quadtree-codec.sock";
+    long long cacheMegabytes = (argc > 2) ? atoll(argv[2]) : 64;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        cerr << "\nCould not initialize sockets!" << endl;
+        return -1;
+    }
+#else
+    // a client hanging up mid-reply must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "\nSocket path too long!" << endl;
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    socket_t listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        cerr << "\nCould not create socket!" << endl;
+        return -1;
+    }
+
+    // remove a stale socket left behind by a previous run
+    remove(socketPath.c_str());
+
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "\nCould not listen on " << socketPath << "!" << endl;
+        return -1;
+    }
+
+    cout << "Listening on " << socketPath << " (tile cache: " << cacheMegabytes << " MB)" << endl;
+
+    Daemon daemon((size_t)max(cacheMegabytes, 0LL) << 20);
+
+    // one thread per connection, the daemon is meant for a handful of local viewers
+    while (true) {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        thread(&Daemon::serve, &daemon, client).detach();
+    }
+
+	// terminate program
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+    Description:    Implementation of the decoded tile LRU cache (see tile-cache.h).
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#include "tile-cache.h"
+
+#include <functional>
+
+using namespace std;
+
+size_t TileKeyHash::operator()(const TileKey& key) const {
+    size_t seed = hash<string>()(key.image);
+    const unsigned long long parts[5] = { key.generation, (unsigned long long)key.x, (unsigned long long)key.y,
+        (unsigned long long)key.rows, (unsigned long long)key.cols };
+
+    // boost style hash combine
+    for (int i = 0; i < 5; i++) {
+        seed ^= hash<unsigned long long>()(parts[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
+
+TileCache::TileCache(size_t capacity) {
+    this->capacity = capacity;
+    bytes = 0;
+    hits = misses = evictions = 0;
+}
+
+TilePixels TileCache::find(const TileKey& key) {
+    lock_guard<mutex> guard(lock);
+
+    auto found = index.find(key);
+    if (found == index.end()) {
+        misses++;
+        return nullptr;
+    }
+
+    // move the entry to the front of the list
+    entries.splice(entries.begin(), entries, found->second);
+    hits++;
+    return found->second->second;
+}
+
+void TileCache::evict(EntryList::iterator entry) {
+    bytes -= entry->second->size();
+    index.erase(entry->first);
+    entries.erase(entry);
+}
+
+void TileCache::insert(const TileKey& key, TilePixels pixels) {
+    lock_guard<mutex> guard(lock);
+
+    if (pixels->size() > capacity) {
+        return;
+    }
+
+    // another thread may have rendered the same tile in the meantime
+    auto found = index.find(key);
+    if (found != index.end()) {
+        evict(found->second);
+    }
+
+    while (bytes + pixels->size() > capacity) {
+        evict(prev(entries.end()));
+        evictions++;
+    }
+
+    entries.emplace_front(key, pixels);
+    index[key] = entries.begin();
+    bytes += pixels->size();
+}
+
+void TileCache::erase(const TileKey& key) {
+    lock_guard<mutex> guard(lock);
+
+    auto found = index.find(key);
+    if (found != index.end()) {
+        evict(found->second);
+    }
+}
+
+void TileCache::eraseImage(const string& image) {
+    lock_guard<mutex> guard(lock);
+
+    for (auto entry = entries.begin(); entry != entries.end();) {
+        auto next = std::next(entry);
+        if (entry->first.image == image) {
+            evict(entry);
+        }
+        entry = next;
+    }
+}
+
+TileCacheStats TileCache::stats() const {
+    lock_guard<mutex> guard(lock);
+
+    TileCacheStats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.evictions = evictions;
+    result.entries = entries.size();
+    result.bytes = bytes;
+    result.capacity = capacity;
+    return result;
+}
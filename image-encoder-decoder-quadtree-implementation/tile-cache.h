@@ -0,0 +1,77 @@
+/*
+    Description:    Size-bounded LRU cache of decoded tiles, used by the codec daemon. Every method
+                    takes the cache's own lock, so one cache can be shared by all connection threads.
+
+    Github:         Please feel free to contribute to this project by submitting pull requests or
+                    reporting bugs through the issue tracker.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// identifies one rendered tile: the image it came from (name + generation, bumped whenever the
+// name is re-loaded) and the tile rectangle
+struct TileKey {
+    std::string image;
+    unsigned long long generation;
+    int x, y, rows, cols;
+
+    bool operator==(const TileKey& other) const {
+        return image == other.image && generation == other.generation && x == other.x && y == other.y &&
+            rows == other.rows && cols == other.cols;
+    }
+};
+
+struct TileKeyHash {
+    std::size_t operator()(const TileKey& key) const;
+};
+
+typedef std::shared_ptr<const std::vector<unsigned char>> TilePixels;
+
+struct TileCacheStats {
+    unsigned long long hits, misses, evictions;
+    std::size_t entries, bytes, capacity;
+};
+
+class TileCache {
+public:
+    // capacity is the maximum number of pixel bytes kept in the cache
+    explicit TileCache(std::size_t capacity);
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+
+    // returns the cached tile (and marks it most recently used) or null on a miss
+    TilePixels find(const TileKey& key);
+
+    // adds a tile, evicting least recently used ones until it fits. tiles larger than the
+    // whole cache are not stored
+    void insert(const TileKey& key, TilePixels pixels);
+
+    // drops a single tile, if it is cached
+    void erase(const TileKey& key);
+
+    // drops every tile of an image, used when it is unloaded or replaced
+    void eraseImage(const std::string& image);
+
+    TileCacheStats stats() const;
+
+private:
+    typedef std::list<std::pair<TileKey, TilePixels>> EntryList;
+
+    mutable std::mutex lock;
+    EntryList entries; // most recently used first
+    std::unordered_map<TileKey, EntryList::iterator, TileKeyHash> index;
+
+    std::size_t capacity, bytes;
+    unsigned long long hits, misses, evictions;
+
+    void evict(EntryList::iterator entry);
+};